@@ -0,0 +1,295 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "riff.h"
+#include "zerocopy.h"
+#include "capture.h"
+
+
+/* seconds since first input */
+static double capture_elapsed(capture *c)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (now.tv_sec - c->started.tv_sec) + (now.tv_nsec - c->started.tv_nsec) / 1e9;
+}
+
+/* a tenth of a second from now, for timed waits */
+static void capture_timeout(struct timespec *t)
+{
+    clock_gettime(CLOCK_REALTIME, t);
+    t->tv_nsec += 100000000;
+    if(t->tv_nsec >= 1000000000)
+    {
+        t->tv_sec++;
+        t->tv_nsec -= 1000000000;
+    }
+}
+
+/* where the next block goes, NULL if the queue has no room for it. blocks
+ * only wrap at the end since size is whole blocks, hold the mutex */
+static int16_t *capture_room(capture *c)
+{
+    int position;
+
+    /* start over at the beginning when nothing is in use */
+    if(c->used == 0)
+        c->first = 0;
+
+    position = (c->first + c->used) % c->size;
+    if(c->size - c->used < c->block_length || c->size - position < c->block_length)
+        return NULL;
+
+    return c->data + position;
+}
+
+/* note input that did not fit, right after an earlier gap it is the same gap */
+static int capture_drop(capture *c, uint64_t length)
+{
+    capture_gap *t;
+
+    if(c->gap_count > 0 && c->gaps[c->gap_count - 1].at == c->queued)
+    {
+        c->gaps[c->gap_count - 1].length += length;
+
+        return 0;
+    }
+
+    t = realloc(c->gaps, (c->gap_count + 1) * sizeof(capture_gap));
+    if(t == NULL)
+    {
+        fprintf(stderr, "capture_drop: realloc failed\n");
+
+        return -1;
+    }
+    c->gaps = t;
+    c->gaps[c->gap_count].at = c->queued;
+    c->gaps[c->gap_count].length = length;
+    c->gap_count++;
+
+    return 0;
+}
+
+static void *capture_thread(void *arg)
+{
+    capture *c = arg;
+    struct timespec t;
+    uint64_t total;
+    int16_t *buffer;
+    int n;
+
+    /* only the read can be cancelled, never while holding the mutex */
+    pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+
+    total = 0;
+    pthread_mutex_lock(&c->mutex);
+    while(c->quit == 0 && c->done == 0)
+    {
+        /* a file, or a pipe ahead of real time, can wait for room. live
+         * input is never ahead by more then was waiting when we started so
+         * the writer does not block, once real time has caught up it is
+         * dropped */
+        while(capture_room(c) == NULL && c->quit == 0 &&
+              (!c->live || total > capture_elapsed(c) * c->sample_rate + c->block_length))
+        {
+            capture_timeout(&t);
+            pthread_cond_timedwait(&c->cond, &c->mutex, &t);
+        }
+        if(c->quit)
+            break;
+
+        /* the part of the queue after what is used is only ours */
+        buffer = capture_room(c);
+        pthread_mutex_unlock(&c->mutex);
+
+        n = c->block_length;
+        if(c->length != 0 && c->length - total < n)
+            n = c->length - total;
+        if(n > 0)
+        {
+            pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+            pthread_testcancel();
+            if(c->zerocopy != NULL)
+                n = zerocopy_read_wave_16(c->zerocopy, (buffer != NULL ? buffer : c->block), n);
+            else
+                n = riff_read_wave_16(c->stream, (buffer != NULL ? buffer : c->block), n);
+            pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        }
+
+        pthread_mutex_lock(&c->mutex);
+        if(n < 1)
+            c->done = (n == -1 ? -1 : 1);
+        else
+        {
+            if(total == 0)
+                clock_gettime(CLOCK_MONOTONIC, &c->started);
+            total += n;
+
+            if(buffer != NULL)
+            {
+                c->used += n;
+                c->queued += n;
+            }
+            else if(capture_drop(c, n) == -1)
+                c->done = -1;
+        }
+        pthread_cond_broadcast(&c->cond);
+    }
+    pthread_mutex_unlock(&c->mutex);
+
+    return NULL;
+}
+
+/* size is samples to queue at most, block_length samples are read at a time
+ * and only length samples if not 0. live input is dropped when the queue is
+ * full unless it comes faster then real time */
+int capture_start(capture *c, FILE *stream, zerocopy *z, int sample_rate,
+                  int size, int block_length, uint64_t length, int live, int *stop)
+{
+    c->stream = stream;
+    c->zerocopy = z;
+    c->sample_rate = sample_rate;
+    c->length = length;
+    c->block_length = block_length;
+    /* whole blocks, room for the one being used while the next is read */
+    c->size = (size < block_length * 2 ? 2 : (size + block_length - 1) / block_length) * block_length;
+    c->first = 0;
+    c->used = 0;
+    c->taken_length = 0;
+    c->queued = 0;
+    c->taken = 0;
+    c->gaps = NULL;
+    c->gap_count = 0;
+    c->live = live;
+    c->stop = stop;
+    c->quit = 0;
+    c->done = 0;
+
+    c->block = malloc(block_length * sizeof(int16_t));
+    c->data = malloc(c->size * sizeof(int16_t));
+    if(c->block == NULL || c->data == NULL)
+    {
+        fprintf(stderr, "capture_start: malloc failed\n");
+        free(c->block);
+        free(c->data);
+
+        return -1;
+    }
+
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->cond, NULL);
+    if(pthread_create(&c->thread, NULL, capture_thread, c) != 0)
+    {
+        fprintf(stderr, "capture_start: pthread_create failed\n");
+        pthread_mutex_destroy(&c->mutex);
+        pthread_cond_destroy(&c->cond);
+        free(c->block);
+        free(c->data);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/* get up to length queued samples, waits for them. buffer points into the
+ * queue until capture_release. returns number of samples, 0 at end of input
+ * or if *stop is set and -1 on read error. input that was dropped is
+ * returned on its own as 0 samples and *lost */
+int capture_read(capture *c, int16_t **buffer, int length, uint64_t *lost)
+{
+    struct timespec t;
+    int n;
+
+    *lost = 0;
+
+    pthread_mutex_lock(&c->mutex);
+    while(c->used == 0 && c->gap_count == 0 && c->done == 0 && *c->stop == 0)
+    {
+        /* signals can go to any thread, look at stop now and then */
+        capture_timeout(&t);
+        pthread_cond_timedwait(&c->cond, &c->mutex, &t);
+    }
+
+    if(c->gap_count > 0 && c->gaps[0].at == c->taken)
+    {
+        *lost = c->gaps[0].length;
+        c->gap_count--;
+        memmove(c->gaps, c->gaps + 1, c->gap_count * sizeof(capture_gap));
+        n = 0;
+    }
+    else if(c->used > 0)
+    {
+        n = (length < c->used ? length : c->used);
+        if(n > c->size - c->first)
+            n = c->size - c->first;
+        if(c->gap_count > 0 && c->gaps[0].at - c->taken < n)
+            n = c->gaps[0].at - c->taken;
+        *buffer = c->data + c->first;
+        c->taken_length = n;
+        c->taken += n;
+    }
+    else
+        n = (c->done == -1 ? -1 : 0);
+    pthread_mutex_unlock(&c->mutex);
+
+    return n;
+}
+
+/* done with what capture_read gave */
+void capture_release(capture *c)
+{
+    pthread_mutex_lock(&c->mutex);
+    c->first = (c->first + c->taken_length) % c->size;
+    c->used -= c->taken_length;
+    c->taken_length = 0;
+    /* reader might wait for room */
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+}
+
+/* stop reading, a read waiting for input is cancelled */
+void capture_stop(capture *c)
+{
+    pthread_mutex_lock(&c->mutex);
+    c->quit = 1;
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+
+    pthread_cancel(c->thread);
+    pthread_join(c->thread, NULL);
+
+    pthread_mutex_destroy(&c->mutex);
+    pthread_cond_destroy(&c->cond);
+    free(c->block);
+    free(c->data);
+    free(c->gaps);
+}
+
@@ -0,0 +1,60 @@
+#ifndef __CAPTURE_H__
+#define __CAPTURE_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "zerocopy.h"
+
+/* input is read by its own thread into a queue so that a stalled output file
+ * system never makes input wait. when the queue is full input that comes in
+ * real time is dropped, input that comes faster (a file) waits. input is
+ * read straight into the queue and used from there, it is never copied */
+struct capture_gap
+{
+    uint64_t at; /* queued samples before the gap */
+    uint64_t length;
+};
+
+typedef struct capture_gap capture_gap;
+
+struct capture
+{
+    FILE *stream;
+    zerocopy *zerocopy; /* read thru zerocopy instead of stream */
+    int sample_rate;
+    uint64_t length; /* samples to read, 0 = until end */
+    int16_t *block; /* input that is dropped is read here */
+    int block_length;
+    int16_t *data; /* queue, whole blocks */
+    int size;
+    int first;
+    int used; /* including taken but not released */
+    int taken_length; /* given out by capture_read */
+    uint64_t queued; /* samples put in queue since start */
+    uint64_t taken;
+    capture_gap *gaps;
+    int gap_count;
+    int live; /* input does not wait for us, drop what does not fit */
+    int *stop; /* capture_read gives up waiting when this is set */
+    int quit;
+    int done; /* 1 at end of input, -1 on read error */
+    struct timespec started;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+};
+
+typedef struct capture capture;
+
+
+int capture_start(capture *c, FILE *stream, zerocopy *z, int sample_rate,
+                  int size, int block_length, uint64_t length, int live, int *stop);
+int capture_read(capture *c, int16_t **buffer, int length, uint64_t *lost);
+void capture_release(capture *c);
+void capture_stop(capture *c);
+
+#endif
+
@@ -0,0 +1,620 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <endian.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+
+#include "catalog.h"
+
+
+/* write all of data at offset, -1 offset appends */
+static int catalog_write(int fd, void *data, int length, off_t offset)
+{
+    ssize_t n;
+
+    while(length > 0)
+    {
+        n = (offset == -1 ? write(fd, data, length) : pwrite(fd, data, length, offset));
+        if(n == -1)
+            return -1;
+        data = (uint8_t *)data + n;
+        length -= n;
+        if(offset != -1)
+            offset += n;
+    }
+
+    return 0;
+}
+
+static void catalog_header_swap(catalog_header *h)
+{
+    h->record_size = le32toh(h->record_size);
+    h->flags = le32toh(h->flags);
+    h->max_duration = le64toh(h->max_duration);
+}
+
+static void catalog_index_swap(catalog_index *x)
+{
+    int i;
+
+    x->records = le32toh(x->records);
+    x->run_count = le32toh(x->run_count);
+    for(i = 0; i < CATALOG_RUNS_MAX; i++)
+        x->run_end[i] = le32toh(x->run_end[i]);
+}
+
+/* le to host and back is the same swap */
+static void catalog_record_swap(catalog_record *r)
+{
+    r->start = le64toh(r->start);
+    r->end = le64toh(r->end);
+    r->offset = le64toh(r->offset);
+    r->path_offset = le64toh(r->path_offset);
+    r->path_length = le32toh(r->path_length);
+    r->sample_rate = le32toh(r->sample_rate);
+    r->peak = le32toh(r->peak);
+}
+
+static int catalog_check_header(catalog_header *h)
+{
+    if(memcmp(h->magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC)) != 0 ||
+       h->record_size != sizeof(catalog_record))
+        return -1;
+
+    return 0;
+}
+
+/* an index that does not add up, after a write that did not finish, is
+ * started over. x is in host order, size is of the index file and count
+ * records in the catalog */
+static void catalog_index_check(catalog_index *x, off_t size, size_t count)
+{
+    uint32_t end = 0;
+    int i;
+
+    if(memcmp(x->magic, CATALOG_INDEX_MAGIC, sizeof(CATALOG_INDEX_MAGIC)) == 0 &&
+       x->run_count <= CATALOG_RUNS_MAX &&
+       x->records <= count &&
+       size >= sizeof(*x) + (off_t)x->records * sizeof(uint32_t))
+    {
+        for(i = 0; i < x->run_count && x->run_end[i] > end; i++)
+            end = x->run_end[i];
+        if(i == x->run_count && end == x->records)
+            return;
+    }
+
+    memset(x, 0, sizeof(*x));
+    memcpy(x->magic, CATALOG_INDEX_MAGIC, sizeof(CATALOG_INDEX_MAGIC));
+}
+
+/* index entries in start order, then in the order they were added */
+static int catalog_compare(const void *a, const void *b, void *map)
+{
+    catalog_record *records = (catalog_record *)((uint8_t *)map + sizeof(catalog_header));
+    uint32_t i = *(uint32_t *)a, j = *(uint32_t *)b;
+    int64_t x = le64toh(records[i].start), y = le64toh(records[j].start);
+
+    if(x != y)
+        return (x < y ? -1 : 1);
+
+    return (i < j ? -1 : i > j);
+}
+
+static int catalog_index_write(catalog *c, catalog_index *x)
+{
+    catalog_index d = *x;
+
+    catalog_index_swap(&d);
+
+    return catalog_write(c->index_fd, &d, sizeof(d), 0);
+}
+
+static uint32_t catalog_run_begin(catalog_index *x, int run)
+{
+    return (run == 0 ? 0 : x->run_end[run - 1]);
+}
+
+/* index the first count records, hold the lock. new records go last in the
+ * last run if they are in order after it, otherwise in a new run, then the
+ * last runs are merged until each run is at least twice the next. a catalog
+ * added to in order stays one run that is only appended to */
+static int catalog_index_update(catalog *c, size_t count)
+{
+    catalog_index x, empty;
+    struct stat st;
+    uint8_t *map;
+    uint32_t *entries = NULL, last, n, i;
+    size_t size;
+    int k, ret = -1;
+
+    if(fstat(c->index_fd, &st) == -1)
+        return -1;
+    if(pread(c->index_fd, &x, sizeof(x), 0) != sizeof(x))
+        memset(&x, 0, sizeof(x));
+    catalog_index_swap(&x);
+    catalog_index_check(&x, st.st_size, count);
+    if(x.records == count)
+        return 0;
+
+    size = sizeof(catalog_header) + count * sizeof(catalog_record);
+    map = mmap(NULL, size, PROT_READ, MAP_SHARED, c->fd, 0);
+    if(map == MAP_FAILED)
+        return -1;
+
+    n = count - x.records;
+    entries = malloc(n * sizeof(uint32_t));
+    if(entries == NULL)
+        goto done;
+    for(i = 0; i < n; i++)
+        entries[i] = x.records + i;
+    qsort_r(entries, n, sizeof(uint32_t), catalog_compare, map);
+
+    if(x.run_count > 0)
+    {
+        if(pread(c->index_fd, &last, sizeof(last),
+                 sizeof(x) + (x.records - 1) * sizeof(last)) != sizeof(last))
+            goto done;
+        last = le32toh(last);
+    }
+    if(x.run_count > 0 && catalog_compare(&last, entries, map) <= 0)
+        x.run_end[x.run_count - 1] += n;
+    else if(x.run_count < CATALOG_RUNS_MAX)
+        x.run_end[x.run_count++] = x.records + n;
+    else
+        goto done;
+
+    for(i = 0; i < n; i++)
+        entries[i] = htole32(entries[i]);
+    if(catalog_write(c->index_fd, entries, n * sizeof(uint32_t),
+                     sizeof(x) + x.records * sizeof(uint32_t)) == -1)
+        goto done;
+    x.records += n;
+
+    /* runs to merge into one */
+    n = x.run_end[x.run_count - 1] - catalog_run_begin(&x, x.run_count - 1);
+    for(k = x.run_count - 1; k > 0; k--)
+    {
+        if(n * 2 <= x.run_end[k - 1] - catalog_run_begin(&x, k - 1))
+            break;
+        n += x.run_end[k - 1] - catalog_run_begin(&x, k - 1);
+    }
+
+    if(k < x.run_count - 1)
+    {
+        free(entries);
+        entries = malloc(n * sizeof(uint32_t));
+        if(entries == NULL ||
+           pread(c->index_fd, entries, n * sizeof(uint32_t),
+                 sizeof(x) + catalog_run_begin(&x, k) * sizeof(uint32_t)) != n * sizeof(uint32_t))
+            goto done;
+        for(i = 0; i < n; i++)
+            entries[i] = le32toh(entries[i]);
+        qsort_r(entries, n, sizeof(uint32_t), catalog_compare, map);
+        for(i = 0; i < n; i++)
+            entries[i] = htole32(entries[i]);
+
+        /* runs are written over, until done the index is empty and the next
+         * add builds it again if something fails */
+        x.run_end[k] = x.records;
+        x.run_count = k + 1;
+        memset(&empty, 0, sizeof(empty));
+        memcpy(empty.magic, CATALOG_INDEX_MAGIC, sizeof(CATALOG_INDEX_MAGIC));
+        if(catalog_index_write(c, &empty) == -1 ||
+           catalog_write(c->index_fd, entries, n * sizeof(uint32_t),
+                         sizeof(x) + catalog_run_begin(&x, k) * sizeof(uint32_t)) == -1)
+            goto done;
+    }
+
+    ret = catalog_index_write(c, &x);
+
+done:
+    free(entries);
+    munmap(map, size);
+
+    return ret;
+}
+
+/* open or create catalog for appending */
+int catalog_open(char *path, catalog *c)
+{
+    catalog_header h;
+    struct stat st;
+    char *paths;
+
+    c->paths_fd = -1;
+    c->index_fd = -1;
+    /* not O_APPEND, pwrite of the header would append too */
+    c->fd = open(path, O_RDWR | O_CREAT, 0666);
+    if(c->fd == -1)
+    {
+        fprintf(stderr, "catalog_open: failed to open %s\n", path);
+
+        return -1;
+    }
+
+    if(flock(c->fd, LOCK_EX) == -1 || fstat(c->fd, &st) == -1)
+    {
+        fprintf(stderr, "catalog_open: failed to lock %s\n", path);
+        catalog_close(c);
+
+        return -1;
+    }
+
+    if(st.st_size == 0)
+    {
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, CATALOG_MAGIC, sizeof(CATALOG_MAGIC));
+        h.record_size = sizeof(catalog_record);
+        catalog_header_swap(&h);
+        if(catalog_write(c->fd, &h, sizeof(h), 0) == -1)
+        {
+            fprintf(stderr, "catalog_open: failed to write header to %s\n", path);
+            catalog_close(c);
+
+            return -1;
+        }
+    }
+    else
+    {
+        if(pread(c->fd, &h, sizeof(h), 0) == sizeof(h))
+            catalog_header_swap(&h);
+        else
+            memset(&h, 0, sizeof(h));
+        if(catalog_check_header(&h) == -1)
+        {
+            fprintf(stderr, "catalog_open: %s is not a catalog\n", path);
+            catalog_close(c);
+
+            return -1;
+        }
+    }
+    flock(c->fd, LOCK_UN);
+
+    if(asprintf(&paths, "%s.paths", path) == -1)
+    {
+        fprintf(stderr, "catalog_open: asprintf failed\n");
+        catalog_close(c);
+
+        return -1;
+    }
+    c->paths_fd = open(paths, O_WRONLY | O_APPEND | O_CREAT, 0666);
+    free(paths);
+    if(c->paths_fd == -1)
+    {
+        fprintf(stderr, "catalog_open: failed to open paths file of %s\n", path);
+        catalog_close(c);
+
+        return -1;
+    }
+
+    if(asprintf(&paths, "%s.index", path) == -1)
+    {
+        fprintf(stderr, "catalog_open: asprintf failed\n");
+        catalog_close(c);
+
+        return -1;
+    }
+    c->index_fd = open(paths, O_RDWR | O_CREAT, 0666);
+    free(paths);
+    if(c->index_fd == -1)
+    {
+        fprintf(stderr, "catalog_open: failed to open index file of %s\n", path);
+        catalog_close(c);
+
+        return -1;
+    }
+
+    pthread_mutex_init(&c->mutex, NULL);
+
+    return 0;
+}
+
+void catalog_close(catalog *c)
+{
+    if(c->fd != -1)
+        close(c->fd);
+    if(c->paths_fd != -1)
+        close(c->paths_fd);
+    if(c->index_fd != -1)
+        close(c->index_fd);
+    c->fd = -1;
+    c->paths_fd = -1;
+    c->index_fd = -1;
+}
+
+/* append record for file at path, path_offset and path_length are filled in.
+ * header goes first, if something fails later it still covers all records */
+int catalog_add(catalog *c, catalog_record *r, char *path)
+{
+    catalog_header h;
+    catalog_record d;
+    struct stat st, paths_st;
+    off_t size;
+    int ret = -1;
+
+    pthread_mutex_lock(&c->mutex);
+    if(flock(c->fd, LOCK_EX) == -1)
+    {
+        fprintf(stderr, "catalog_add: flock failed\n");
+        pthread_mutex_unlock(&c->mutex);
+
+        return -1;
+    }
+
+    if(pread(c->fd, &h, sizeof(h), 0) != sizeof(h) ||
+       fstat(c->fd, &st) == -1 ||
+       fstat(c->paths_fd, &paths_st) == -1)
+    {
+        fprintf(stderr, "catalog_add: failed to read header\n");
+        goto done;
+    }
+    catalog_header_swap(&h);
+
+    /* a record cut short by an earlier failed write is written over */
+    size = sizeof(h) + (st.st_size - sizeof(h)) / sizeof(d) * sizeof(d);
+
+    if(r->end - r->start > h.max_duration)
+        h.max_duration = r->end - r->start;
+    catalog_header_swap(&h);
+    if(catalog_write(c->fd, &h, sizeof(h), 0) == -1)
+    {
+        fprintf(stderr, "catalog_add: failed to write header\n");
+        goto done;
+    }
+
+    r->path_offset = paths_st.st_size;
+    r->path_length = strlen(path);
+    d = *r;
+    catalog_record_swap(&d);
+    if(catalog_write(c->paths_fd, path, r->path_length, -1) == -1 ||
+       catalog_write(c->paths_fd, "\n", 1, -1) == -1)
+    {
+        fprintf(stderr, "catalog_add: failed to write path\n");
+        /* a partial path is never pointed to, just wastes space */
+        goto done;
+    }
+    if(catalog_write(c->fd, &d, sizeof(d), size) == -1)
+    {
+        fprintf(stderr, "catalog_add: failed to write record\n");
+        goto done;
+    }
+
+    /* queries look at records that are not indexed one by one */
+    if(catalog_index_update(c, (size - sizeof(h)) / sizeof(d) + 1) == -1)
+        fprintf(stderr, "catalog_add: failed to update index\n");
+
+    ret = 0;
+
+done:
+    flock(c->fd, LOCK_UN);
+    pthread_mutex_unlock(&c->mutex);
+
+    return ret;
+}
+
+/* found records in start order, then in the order they were added */
+static int catalog_found_compare(const void *a, const void *b)
+{
+    const catalog_record *x = a, *y = b;
+
+    if(x->start != y->start)
+        return (x->start < y->start ? -1 : 1);
+
+    return (x->path_offset < y->path_offset ? -1 : x->path_offset > y->path_offset);
+}
+
+/* keep record if it overlaps from to to */
+static int catalog_match(catalog_record **list, size_t *used, size_t *size,
+                         catalog_record *r, int64_t from, off_t paths_size)
+{
+    catalog_record *t;
+
+    /* paths file is written before record, but can be cut short */
+    if(r->end <= from || r->path_offset + r->path_length > paths_size)
+        return 0;
+
+    if(*used == *size)
+    {
+        t = realloc(*list, (*size * 2 + 16) * sizeof(catalog_record));
+        if(t == NULL)
+            return -1;
+        *list = t;
+        *size = *size * 2 + 16;
+    }
+    (*list)[(*used)++] = *r;
+
+    return 0;
+}
+
+/* find records overlapping from to to, in milliseconds, and give them to found
+ * in start order. each sorted run of the index is binary searched, records
+ * not indexed yet are looked at one by one. returns number found or -1 */
+int catalog_query(char *path, int64_t from, int64_t to, catalog_found found, void *user)
+{
+    catalog_header h;
+    catalog_index x;
+    catalog_record *records, r, *list = NULL;
+    struct stat st, paths_st, index_st;
+    char *paths_path, *index_path, *text;
+    uint8_t *map, *paths = NULL, *index = NULL;
+    uint32_t *entries;
+    int64_t first;
+    size_t count, low, high, middle, i, used = 0, size = 0;
+    int fd, paths_fd, index_fd, run, n = 0;
+
+    if(asprintf(&paths_path, "%s.paths", path) == -1)
+    {
+        fprintf(stderr, "catalog_query: asprintf failed\n");
+
+        return -1;
+    }
+    if(asprintf(&index_path, "%s.index", path) == -1)
+    {
+        fprintf(stderr, "catalog_query: asprintf failed\n");
+        free(paths_path);
+
+        return -1;
+    }
+    fd = open(path, O_RDONLY);
+    paths_fd = open(paths_path, O_RDONLY);
+    /* no index just means looking at all records */
+    index_fd = open(index_path, O_RDONLY);
+    free(paths_path);
+    free(index_path);
+    /* runs are written over when merged, hold off adds while searching */
+    if(fd == -1 || paths_fd == -1 || flock(fd, LOCK_SH) == -1 ||
+       fstat(fd, &st) == -1 || fstat(paths_fd, &paths_st) == -1 ||
+       st.st_size < sizeof(h))
+    {
+        fprintf(stderr, "catalog_query: failed to open %s\n", path);
+        if(fd != -1)
+            close(fd);
+        if(paths_fd != -1)
+            close(paths_fd);
+        if(index_fd != -1)
+            close(index_fd);
+
+        return -1;
+    }
+    if(index_fd != -1 && (fstat(index_fd, &index_st) == -1 || index_st.st_size < sizeof(x)))
+    {
+        close(index_fd);
+        index_fd = -1;
+    }
+
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if(paths_st.st_size > 0)
+        paths = mmap(NULL, paths_st.st_size, PROT_READ, MAP_SHARED, paths_fd, 0);
+    if(index_fd != -1)
+        index = mmap(NULL, index_st.st_size, PROT_READ, MAP_SHARED, index_fd, 0);
+    close(paths_fd);
+    if(index_fd != -1)
+        close(index_fd);
+    if(map == MAP_FAILED || paths == MAP_FAILED || index == MAP_FAILED)
+    {
+        fprintf(stderr, "catalog_query: mmap failed\n");
+        if(map != MAP_FAILED)
+            munmap(map, st.st_size);
+        if(paths != NULL && paths != MAP_FAILED)
+            munmap(paths, paths_st.st_size);
+        if(index != NULL && index != MAP_FAILED)
+            munmap(index, index_st.st_size);
+        close(fd);
+
+        return -1;
+    }
+
+    memcpy(&h, map, sizeof(h));
+    catalog_header_swap(&h);
+    if(catalog_check_header(&h) == -1)
+    {
+        fprintf(stderr, "catalog_query: %s is not a catalog\n", path);
+        n = -1;
+        goto done;
+    }
+    records = (catalog_record *)(map + sizeof(h));
+    count = (st.st_size - sizeof(h)) / sizeof(catalog_record);
+
+    if(index != NULL)
+        memcpy(&x, index, sizeof(x));
+    else
+        memset(&x, 0, sizeof(x));
+    catalog_index_swap(&x);
+    catalog_index_check(&x, (index != NULL ? index_st.st_size : 0), count);
+    entries = (index != NULL ? (uint32_t *)(index + sizeof(x)) : NULL);
+
+    /* first in each run that can reach from, nothing starting before that can */
+    first = from - h.max_duration;
+    for(run = 0; run < x.run_count; run++)
+    {
+        low = catalog_run_begin(&x, run);
+        high = x.run_end[run];
+        while(low < high)
+        {
+            middle = low + (high - low) / 2;
+            if((int64_t)le64toh(records[le32toh(entries[middle])].start) < first)
+                low = middle + 1;
+            else
+                high = middle;
+        }
+
+        for(i = low; i < x.run_end[run]; i++)
+        {
+            r = records[le32toh(entries[i])];
+            catalog_record_swap(&r);
+            if(r.start >= to)
+                break;
+            if(catalog_match(&list, &used, &size, &r, from, paths_st.st_size) == -1)
+                goto failed;
+        }
+    }
+
+    for(i = x.records; i < count; i++)
+    {
+        r = records[i];
+        catalog_record_swap(&r);
+        if(r.start < to &&
+           catalog_match(&list, &used, &size, &r, from, paths_st.st_size) == -1)
+            goto failed;
+    }
+
+    qsort(list, used, sizeof(catalog_record), catalog_found_compare);
+    for(i = 0; i < used; i++)
+    {
+        text = strndup((char *)paths + list[i].path_offset, list[i].path_length);
+        if(text == NULL)
+            goto failed;
+        n++;
+        if(found(user, &list[i], text) == -1)
+        {
+            free(text);
+            break;
+        }
+        free(text);
+    }
+
+    goto done;
+
+failed:
+    fprintf(stderr, "catalog_query: out of memory\n");
+    n = -1;
+
+done:
+    free(list);
+    munmap(map, st.st_size);
+    if(paths != NULL)
+        munmap(paths, paths_st.st_size);
+    if(index != NULL)
+        munmap(index, index_st.st_size);
+    close(fd);
+
+    return n;
+}
+
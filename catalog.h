@@ -0,0 +1,73 @@
+#ifndef __CATALOG_H__
+#define __CATALOG_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+/* catalog file is a header and fixed size records, little endian, only ever
+ * appended to, in the order clips finish. paths are in a second file with
+ * ".paths" appended, one per line. a third file with ".index" appended has
+ * record numbers in start order, in a few sorted runs */
+#define CATALOG_MAGIC "LRKCAT1"
+#define CATALOG_INDEX_MAGIC "LRKIDX1"
+#define CATALOG_RUNS_MAX 32
+
+struct catalog_header
+{
+    char magic[8];
+    uint32_t record_size;
+    uint32_t flags; /* none yet */
+    int64_t max_duration; /* longest clip, milliseconds */
+    uint8_t reserved[40];
+};
+
+typedef struct catalog_header catalog_header;
+
+/* followed by uint32_t record numbers, run n is the ones before run_end[n]
+ * and after the run before it. each run is at least twice as long as the
+ * next one so there are never many */
+struct catalog_index
+{
+    char magic[8];
+    uint32_t records; /* indexed, records after these are not yet */
+    uint32_t run_count;
+    uint32_t run_end[CATALOG_RUNS_MAX];
+};
+
+typedef struct catalog_index catalog_index;
+
+struct catalog_record
+{
+    int64_t start; /* milliseconds since epoch */
+    int64_t end;
+    uint64_t offset; /* samples from start of input */
+    uint64_t path_offset; /* in paths file */
+    uint32_t path_length;
+    uint32_t sample_rate;
+    int32_t peak; /* largest absolute sample */
+    uint32_t reserved;
+};
+
+typedef struct catalog_record catalog_record;
+
+struct catalog
+{
+    int fd;
+    int paths_fd;
+    int index_fd;
+    pthread_mutex_t mutex; /* flock only keeps other processes out */
+};
+
+typedef struct catalog catalog;
+
+/* called for each record found by catalog_query, return -1 to stop */
+typedef int (*catalog_found)(void *user, catalog_record *r, char *path);
+
+
+int catalog_open(char *path, catalog *c);
+int catalog_add(catalog *c, catalog_record *r, char *path);
+void catalog_close(catalog *c);
+int catalog_query(char *path, int64_t from, int64_t to, catalog_found found, void *user);
+
+#endif
+
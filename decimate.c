@@ -0,0 +1,73 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "decimate.h"
+
+
+int decimator_init(decimator *d, int factor, int max_length)
+{
+    if(factor < 1)
+        factor = 1;
+
+    d->buffer = malloc((max_length / factor + 1) * sizeof(int16_t));
+    if(d->buffer == NULL)
+    {
+        fprintf(stderr, "decimator_init: malloc buffer failed\n");
+
+        return -1;
+    }
+
+    d->factor = factor;
+    d->phase = 0;
+    d->length = 0;
+
+    return 0;
+}
+
+void decimator_free(decimator *d)
+{
+    free(d->buffer);
+    d->buffer = NULL;
+}
+
+/* keep one polyphase branch, every factor:th sample, without a lowpass
+ * filter in front. for level detection this is what we want, aliasing folds
+ * energy above the new nyquist frequency down instead of removing it, so
+ * ultrasonic sounds still trigger and the mean power stays the same. returns
+ * number of samples put in d->buffer */
+int decimator_process(decimator *d, int16_t *buffer, int length)
+{
+    int i, n;
+
+    n = 0;
+    for(i = d->phase; i < length; i += d->factor)
+        d->buffer[n++] = buffer[i];
+
+    /* continue at the right sample in next slice */
+    d->phase = i - length;
+    d->length = n;
+
+    return n;
+}
+
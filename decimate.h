@@ -0,0 +1,22 @@
+#ifndef __DECIMATE_H__
+#define __DECIMATE_H__
+
+#include <stdint.h>
+
+struct decimator
+{
+    int factor;
+    int phase; /* samples left to skip before next pick, kept between slices */
+    int16_t *buffer; /* decimated samples from last call */
+    int length;
+};
+
+typedef struct decimator decimator;
+
+
+int decimator_init(decimator *d, int factor, int max_length);
+void decimator_free(decimator *d);
+int decimator_process(decimator *d, int16_t *buffer, int length);
+
+#endif
+
@@ -0,0 +1,94 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "energy.h"
+
+
+int energy_window_init(energy_window *e, int length, int hop)
+{
+    if(length < 1)
+        length = 1;
+    if(hop < 1)
+        hop = 1;
+
+    /* start with a window full of silence */
+    e->history = calloc(length, sizeof(int16_t));
+    if(e->history == NULL)
+    {
+        fprintf(stderr, "energy_window_init: calloc history failed\n");
+
+        return -1;
+    }
+
+    e->length = length;
+    e->position = 0;
+    e->hop = hop;
+    e->hop_position = 0;
+    e->sum = 0;
+
+    return 0;
+}
+
+void energy_window_free(energy_window *e)
+{
+    free(e->history);
+    e->history = NULL;
+}
+
+/* slide window over buffer one sample at a time, the sum of squares is kept
+ * exact in integers so it never drifts. returns the loudest window RMS seen at
+ * a hop point, or the current window if no hop point was passed */
+double energy_window_process(energy_window *e, int16_t *buffer, int length)
+{
+    int i;
+    int32_t old;
+    uint64_t peak = 0;
+    int evaluated = 0;
+
+    for(i = 0; i < length; i++)
+    {
+        old = e->history[e->position];
+        e->sum -= old * old;
+        e->sum += buffer[i] * buffer[i];
+        e->history[e->position] = buffer[i];
+
+        if(++e->position == e->length)
+            e->position = 0;
+
+        if(++e->hop_position == e->hop)
+        {
+            e->hop_position = 0;
+            evaluated = 1;
+            if(e->sum > peak)
+                peak = e->sum;
+        }
+    }
+
+    if(evaluated == 0)
+        peak = e->sum;
+
+    return sqrt((double)peak / e->length) / INT16_MAX;
+}
+
@@ -0,0 +1,24 @@
+#ifndef __ENERGY_H__
+#define __ENERGY_H__
+
+#include <stdint.h>
+
+struct energy_window
+{
+    int16_t *history; /* last length samples, ring buffer */
+    int length;
+    int position;
+    int hop;
+    int hop_position;
+    uint64_t sum; /* sum of squares of samples in history */
+};
+
+typedef struct energy_window energy_window;
+
+
+int energy_window_init(energy_window *e, int length, int hop);
+void energy_window_free(energy_window *e);
+double energy_window_process(energy_window *e, int16_t *buffer, int length);
+
+#endif
+
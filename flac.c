@@ -0,0 +1,763 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/types.h>
+#include <endian.h>
+
+#include "riff.h"
+#include "wav.h"
+#include "flac.h"
+
+
+/* https://xiph.org/flac/format.html, only what lurker can use is supported,
+ * 16 bit mono. frame CRCs are not checked */
+
+#define FLAC_PLACEHOLDER 0xffffffffffffffffULL
+
+struct flac_seekpoint
+{
+    uint64_t sample;
+    uint64_t offset; /* from first frame */
+};
+
+typedef struct flac_seekpoint flac_seekpoint;
+
+struct flac_decoder
+{
+    FILE *stream;
+    uint8_t buffer[4096];
+    int buffer_length;
+    int buffer_position;
+    uint64_t bits; /* next bit at the top, rest is zero */
+    int bit_count;
+    int error; /* ran out of input or broken stream */
+
+    int sample_rate;
+    int channels;
+    int bits_per_sample;
+    int max_block_size;
+    uint64_t total_samples; /* 0 = unknown */
+    off_t first_frame; /* -1 if input can not seek */
+    flac_seekpoint *seekpoints;
+    int seekpoint_count;
+
+    int32_t *samples;
+    uint8_t *pcm; /* current frame as 16 bit little endian */
+    int pcm_length; /* bytes */
+    int pcm_position;
+    uint64_t position; /* sample number of first sample in pcm */
+    uint64_t next_position; /* where next frame should start */
+    uint64_t silence; /* samples to play before pcm, for lost frames */
+};
+
+typedef struct flac_decoder flac_decoder;
+
+
+static void flac_refill(flac_decoder *d)
+{
+    while(d->bit_count <= 56)
+    {
+        if(d->buffer_position == d->buffer_length)
+        {
+            d->buffer_length = fread(d->buffer, 1, sizeof(d->buffer), d->stream);
+            d->buffer_position = 0;
+            if(d->buffer_length == 0)
+                return;
+        }
+        d->bits |= (uint64_t)d->buffer[d->buffer_position++] << (56 - d->bit_count);
+        d->bit_count += 8;
+    }
+}
+
+/* n is 0-32 */
+static uint32_t flac_bits(flac_decoder *d, int n)
+{
+    uint32_t v;
+
+    if(n == 0)
+        return 0;
+    if(d->bit_count < n)
+    {
+        flac_refill(d);
+        if(d->bit_count < n)
+        {
+            d->error = 1;
+
+            return 0;
+        }
+    }
+
+    v = d->bits >> (64 - n);
+    d->bits <<= n;
+    d->bit_count -= n;
+
+    return v;
+}
+
+static int32_t flac_signed(flac_decoder *d, int n)
+{
+    if(n == 0)
+        return 0;
+
+    return (int32_t)(flac_bits(d, n) << (32 - n)) >> (32 - n);
+}
+
+/* number of zero bits before next one bit */
+static uint32_t flac_unary(flac_decoder *d)
+{
+    uint32_t n = 0;
+    int z;
+
+    while(1)
+    {
+        if(d->bits == 0)
+        {
+            n += d->bit_count;
+            d->bit_count = 0;
+            flac_refill(d);
+            if(d->bit_count == 0)
+            {
+                d->error = 1;
+
+                return 0;
+            }
+
+            continue;
+        }
+
+        z = __builtin_clzll(d->bits);
+        d->bits = (z == 63 ? 0 : d->bits << (z + 1));
+        d->bit_count -= z + 1;
+
+        return n + z;
+    }
+}
+
+static void flac_align(flac_decoder *d)
+{
+    flac_bits(d, d->bit_count % 8);
+}
+
+/* forget buffered input, after the stream has been moved */
+static void flac_reset(flac_decoder *d)
+{
+    d->buffer_length = 0;
+    d->buffer_position = 0;
+    d->bits = 0;
+    d->bit_count = 0;
+    d->error = 0;
+}
+
+static void flac_skip(flac_decoder *d, uint64_t bytes)
+{
+    int n;
+
+    while(bytes > 0 && d->bit_count >= 8)
+    {
+        flac_bits(d, 8);
+        bytes--;
+    }
+
+    n = d->buffer_length - d->buffer_position;
+    if(n > bytes)
+        n = bytes;
+    d->buffer_position += n;
+    bytes -= n;
+
+    if(bytes > 0 && fseeko(d->stream, bytes, SEEK_CUR) == -1)
+        while(bytes > 0 && !d->error)
+        {
+            flac_bits(d, 8);
+            bytes--;
+        }
+}
+
+static int flac_residual(flac_decoder *d, int32_t *out, int length, int order)
+{
+    int method, partition_order, parameter_bits, escape;
+    int p, i, n, k, end;
+    uint32_t v;
+
+    method = flac_bits(d, 2);
+    if(method > 1)
+    {
+        fprintf(stderr, "flac_residual: unknown coding method %d\n", method);
+
+        return -1;
+    }
+    parameter_bits = (method == 0 ? 4 : 5);
+    escape = (1 << parameter_bits) - 1;
+
+    partition_order = flac_bits(d, 4);
+    if((length >> partition_order) < order ||
+       (length & ((1 << partition_order) - 1)) != 0)
+    {
+        fprintf(stderr, "flac_residual: bad partition order %d\n", partition_order);
+
+        return -1;
+    }
+
+    i = order;
+    for(p = 0; p < (1 << partition_order); p++)
+    {
+        n = (length >> partition_order) - (p == 0 ? order : 0);
+        end = i + n;
+        k = flac_bits(d, parameter_bits);
+
+        if(k == escape)
+        {
+            k = flac_bits(d, 5);
+            for(; i < end; i++)
+                out[i] = flac_signed(d, k);
+        }
+        else
+            for(; i < end && !d->error; i++)
+            {
+                v = (flac_unary(d) << k) | flac_bits(d, k);
+                out[i] = (v >> 1) ^ -(v & 1);
+            }
+
+        if(d->error)
+            return -1;
+    }
+
+    return 0;
+}
+
+static int flac_subframe(flac_decoder *d, int32_t *out, int length, int bits)
+{
+    int type, wasted, order, precision, shift;
+    int32_t coefficients[32];
+    int64_t sum;
+    int i, j;
+
+    flac_bits(d, 1); /* padding */
+    type = flac_bits(d, 6);
+    wasted = 0;
+    if(flac_bits(d, 1))
+        wasted = flac_unary(d) + 1;
+    bits -= wasted;
+    if(bits < 1 || d->error)
+        return -1;
+
+    if(type == 0)
+    {
+        /* constant */
+        out[0] = flac_signed(d, bits);
+        for(i = 1; i < length; i++)
+            out[i] = out[0];
+    }
+    else if(type == 1)
+    {
+        /* verbatim */
+        for(i = 0; i < length; i++)
+            out[i] = flac_signed(d, bits);
+    }
+    else if(type >= 8 && type <= 12)
+    {
+        /* fixed polynomial predictor */
+        order = type - 8;
+        if(order > length)
+            return -1;
+        for(i = 0; i < order; i++)
+            out[i] = flac_signed(d, bits);
+        if(flac_residual(d, out, length, order) == -1)
+            return -1;
+
+        if(order == 1)
+            for(i = 1; i < length; i++)
+                out[i] += out[i - 1];
+        else if(order == 2)
+            for(i = 2; i < length; i++)
+                out[i] += 2 * out[i - 1] - out[i - 2];
+        else if(order == 3)
+            for(i = 3; i < length; i++)
+                out[i] += 3 * out[i - 1] - 3 * out[i - 2] + out[i - 3];
+        else if(order == 4)
+            for(i = 4; i < length; i++)
+                out[i] += 4 * out[i - 1] - 6 * out[i - 2] + 4 * out[i - 3] - out[i - 4];
+    }
+    else if(type >= 32)
+    {
+        /* linear predictor */
+        order = type - 31;
+        if(order > length)
+            return -1;
+        for(i = 0; i < order; i++)
+            out[i] = flac_signed(d, bits);
+        precision = flac_bits(d, 4) + 1;
+        shift = flac_signed(d, 5);
+        if(precision == 16 || shift < 0)
+        {
+            fprintf(stderr, "flac_subframe: bad LPC precision %d or shift %d\n", precision, shift);
+
+            return -1;
+        }
+        for(i = 0; i < order; i++)
+            coefficients[i] = flac_signed(d, precision);
+        if(flac_residual(d, out, length, order) == -1)
+            return -1;
+
+        for(i = order; i < length; i++)
+        {
+            sum = 0;
+            for(j = 0; j < order; j++)
+                sum += (int64_t)coefficients[j] * out[i - 1 - j];
+            out[i] += sum >> shift;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "flac_subframe: reserved subframe type %d\n", type);
+
+        return -1;
+    }
+
+    if(wasted > 0)
+        for(i = 0; i < length; i++)
+            out[i] <<= wasted;
+
+    return (d->error ? -1 : 0);
+}
+
+static uint8_t flac_crc8(uint8_t *data, int length)
+{
+    uint8_t crc = 0;
+    int i, j;
+
+    for(i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for(j = 0; j < 8; j++)
+            crc = (crc & 0x80 ? (crc << 1) ^ 0x07 : crc << 1);
+    }
+
+    return crc;
+}
+
+/* decode next frame to pcm, returns 1 if there was one, 0 at end of stream */
+static int flac_frame(flac_decoder *d)
+{
+    uint8_t header[16];
+    uint32_t x, y;
+    uint64_t number;
+    int block_code, rate_code, assignment, block_size, h, n, i;
+
+    flac_align(d);
+
+    while(1)
+    {
+        /* sync code, anything in front of it is skipped */
+        x = flac_bits(d, 8);
+        y = 0;
+        while(!d->error)
+        {
+            y = flac_bits(d, 8);
+            if(x == 0xff && (y & 0xfe) == 0xf8)
+                break;
+            x = y;
+        }
+        if(d->error)
+            return 0;
+
+        h = 0;
+        header[h++] = x;
+        header[h++] = y;
+        header[h++] = x = flac_bits(d, 8);
+        block_code = x >> 4;
+        rate_code = x & 0x0f;
+        header[h++] = x = flac_bits(d, 8);
+        assignment = x >> 4;
+
+        /* frame or sample number, utf-8 style coded */
+        header[h++] = number = flac_bits(d, 8);
+        for(n = 0; n < 8 && (number & (0x80 >> n)); n++)
+            ;
+        if(n == 1 || n > 7)
+            continue;
+        if(n > 1)
+            number &= 0x7f >> n;
+        for(i = 1; i < n; i++)
+        {
+            header[h++] = x = flac_bits(d, 8);
+            number = (number << 6) | (x & 0x3f);
+        }
+
+        block_size = 0;
+        if(block_code == 6 || block_code == 7)
+        {
+            header[h++] = x = flac_bits(d, 8);
+            block_size = x;
+            if(block_code == 7)
+            {
+                header[h++] = x = flac_bits(d, 8);
+                block_size = (block_size << 8) | x;
+            }
+            block_size++;
+        }
+        if(rate_code >= 12 && rate_code <= 14)
+            header[h++] = flac_bits(d, 8);
+        if(rate_code >= 13 && rate_code <= 14)
+            header[h++] = flac_bits(d, 8);
+
+        /* a sync code can also show up inside a frame */
+        if(flac_bits(d, 8) != flac_crc8(header, h) || d->error)
+            continue;
+
+        if(block_code == 1)
+            block_size = 192;
+        else if(block_code >= 2 && block_code <= 5)
+            block_size = 576 << (block_code - 2);
+        else if(block_code >= 8)
+            block_size = 256 << (block_code - 8);
+
+        if(block_size != 0 && block_size <= d->max_block_size && assignment == 0)
+            break;
+
+        /* can not be decoded, keep looking. the frame is played as silence
+         * when the next one is found */
+        fprintf(stderr, "flac_frame: unsupported frame header at sample %llu, skipped\n",
+                (unsigned long long)(y & 1 ? number : number * d->max_block_size));
+    }
+
+    /* fixed block size streams count frames */
+    d->position = (y & 1 ? number : number * d->max_block_size);
+    d->pcm_length = 0;
+    d->pcm_position = 0;
+
+    if(flac_subframe(d, d->samples, block_size, d->bits_per_sample) == -1)
+    {
+        if(d->error)
+        {
+            fprintf(stderr, "flac_frame: stream ends inside a frame\n");
+
+            return 0;
+        }
+
+        /* header was fine so time is known, play silence and look for
+         * next frame */
+        fprintf(stderr, "flac_frame: broken frame at sample %llu, replaced by silence\n",
+                (unsigned long long)d->position);
+        memset(d->samples, 0, block_size * sizeof(int32_t));
+    }
+    else
+    {
+        flac_align(d);
+        flac_bits(d, 16); /* frame crc, not checked */
+    }
+
+    for(i = 0; i < block_size; i++)
+        ((int16_t *)d->pcm)[i] = htole16(d->samples[i]);
+    d->pcm_length = block_size * sizeof(int16_t);
+
+    return 1;
+}
+
+/* position at sample, jumps using the seek table if there is one and input
+ * can seek, otherwise decodes forward */
+static int flac_seek(flac_decoder *d, uint64_t sample)
+{
+    flac_seekpoint *p = NULL;
+    int i;
+
+    if(sample < d->position || sample >= d->position + d->pcm_length / 2)
+    {
+        for(i = 0; i < d->seekpoint_count && d->seekpoints[i].sample <= sample; i++)
+            p = &d->seekpoints[i];
+
+        /* jump if going back, or if it skips decoding something */
+        if(d->first_frame != -1 &&
+           (sample < d->position || (p != NULL && p->sample > d->position + d->pcm_length / 2)) &&
+           fseeko(d->stream, d->first_frame + (p == NULL ? 0 : p->offset), SEEK_SET) == 0)
+        {
+            flac_reset(d);
+            d->position = (p == NULL ? 0 : p->sample);
+            d->pcm_length = 0;
+            d->pcm_position = 0;
+        }
+        else if(sample < d->position)
+        {
+            fprintf(stderr, "flac_seek: can not seek back in input\n");
+
+            return -1;
+        }
+
+        while(d->pcm_length == 0 || sample >= d->position + d->pcm_length / 2)
+        {
+            if(flac_frame(d) == 0)
+            {
+                /* past end, next read gives end of file */
+                d->pcm_position = d->pcm_length;
+
+                return 0;
+            }
+            if(sample < d->position)
+            {
+                fprintf(stderr, "flac_seek: seek table does not match stream\n");
+
+                return -1;
+            }
+        }
+    }
+
+    d->pcm_position = (sample - d->position) * sizeof(int16_t);
+    d->next_position = d->position + d->pcm_length / sizeof(int16_t);
+    d->silence = 0;
+
+    return 0;
+}
+
+static ssize_t flac_read(void *cookie, char *buffer, size_t size)
+{
+    flac_decoder *d = cookie;
+    size_t n = 0;
+    int r;
+
+    while(n < size)
+    {
+        if(d->silence > 0)
+        {
+            r = (size - n) / sizeof(int16_t);
+            if(r > d->silence)
+                r = d->silence;
+            if(r == 0)
+                break;
+            memset(buffer + n, 0, r * sizeof(int16_t));
+            d->silence -= r;
+            n += r * sizeof(int16_t);
+
+            continue;
+        }
+
+        if(d->pcm_position == d->pcm_length)
+        {
+            if(flac_frame(d) == 0)
+                break;
+
+            /* frames that could not be found are played as silence */
+            if(d->position > d->next_position)
+            {
+                fprintf(stderr, "flac_read: lost %llu samples at sample %llu, replaced by silence\n",
+                        (unsigned long long)(d->position - d->next_position),
+                        (unsigned long long)d->next_position);
+                d->silence = d->position - d->next_position;
+            }
+            d->next_position = d->position + d->pcm_length / sizeof(int16_t);
+
+            continue;
+        }
+
+        r = d->pcm_length - d->pcm_position;
+        if(r > size - n)
+            r = size - n;
+        memcpy(buffer + n, d->pcm + d->pcm_position, r);
+        d->pcm_position += r;
+        n += r;
+    }
+
+    return n;
+}
+
+/* positions are bytes of decoded 16 bit audio */
+static int flac_cookie_seek(void *cookie, off64_t *offset, int whence)
+{
+    flac_decoder *d = cookie;
+    off64_t target;
+
+    target = *offset;
+    if(whence == SEEK_CUR)
+        target += (d->position - d->silence) * sizeof(int16_t) + d->pcm_position;
+    else if(whence == SEEK_END)
+    {
+        if(d->total_samples == 0)
+            return -1;
+        target += d->total_samples * sizeof(int16_t);
+    }
+
+    if(target < 0 || target % sizeof(int16_t) != 0 ||
+       flac_seek(d, target / sizeof(int16_t)) == -1)
+        return -1;
+
+    *offset = target;
+
+    return 0;
+}
+
+static int flac_close(void *cookie)
+{
+    flac_decoder *d = cookie;
+
+    fclose(d->stream);
+    free(d->seekpoints);
+    free(d->samples);
+    free(d->pcm);
+    free(d);
+
+    return 0;
+}
+
+static int flac_metadata(flac_decoder *d)
+{
+    int last, type, i;
+    uint32_t x, length;
+    uint64_t sample, offset;
+    flac_seekpoint *t;
+
+    /* skip id3v2 tag some programs put in front */
+    x = flac_bits(d, 24);
+    if(x == 0x494433)
+    {
+        flac_bits(d, 16); /* version */
+        i = flac_bits(d, 8);
+        length = 0;
+        for(type = 0; type < 4; type++)
+            length = (length << 7) | (flac_bits(d, 8) & 0x7f);
+        flac_skip(d, length + (i & 0x10 ? 10 : 0));
+        x = flac_bits(d, 24);
+    }
+    if(x != 0x664c61 || flac_bits(d, 8) != 'C')
+    {
+        fprintf(stderr, "flac_metadata: not a FLAC stream\n");
+
+        return -1;
+    }
+
+    do
+    {
+        last = flac_bits(d, 1);
+        type = flac_bits(d, 7);
+        length = flac_bits(d, 24);
+
+        if(type == 0)
+        {
+            flac_bits(d, 16); /* min block size */
+            d->max_block_size = flac_bits(d, 16);
+            flac_bits(d, 24); /* min and max frame size */
+            flac_bits(d, 24);
+            d->sample_rate = flac_bits(d, 20);
+            d->channels = flac_bits(d, 3) + 1;
+            d->bits_per_sample = flac_bits(d, 5) + 1;
+            d->total_samples = (uint64_t)flac_bits(d, 4) << 32;
+            d->total_samples |= flac_bits(d, 32);
+            flac_skip(d, 16); /* md5 */
+        }
+        else if(type == 3)
+        {
+            for(i = 0; i < length / 18; i++)
+            {
+                sample = (uint64_t)flac_bits(d, 32) << 32;
+                sample |= flac_bits(d, 32);
+                offset = (uint64_t)flac_bits(d, 32) << 32;
+                offset |= flac_bits(d, 32);
+                flac_bits(d, 16); /* samples in frame */
+                if(sample == FLAC_PLACEHOLDER)
+                    continue;
+
+                t = realloc(d->seekpoints, (d->seekpoint_count + 1) * sizeof(flac_seekpoint));
+                if(t == NULL)
+                {
+                    fprintf(stderr, "flac_metadata: realloc seekpoints failed\n");
+
+                    return -1;
+                }
+                d->seekpoints = t;
+                d->seekpoints[d->seekpoint_count].sample = sample;
+                d->seekpoints[d->seekpoint_count].offset = offset;
+                d->seekpoint_count++;
+            }
+            flac_skip(d, length % 18);
+        }
+        else
+            flac_skip(d, length);
+
+        if(d->error)
+        {
+            fprintf(stderr, "flac_metadata: stream ended in metadata\n");
+
+            return -1;
+        }
+    } while(!last);
+
+    /* where frames start, taking what is buffered into account */
+    d->first_frame = ftello(d->stream);
+    if(d->first_frame != -1)
+        d->first_frame -= d->buffer_length - d->buffer_position + d->bit_count / 8;
+
+    return 0;
+}
+
+/* stream starts with "fLaC" or an id3 tag, decoded audio is read from
+ * w->stream as from a wav file. closes stream on failure */
+int flac_open_stream(FILE *stream, wav_file *w)
+{
+    flac_decoder *d;
+    cookie_io_functions_t io = {flac_read, NULL, flac_cookie_seek, flac_close};
+    FILE *decoded;
+
+    d = calloc(1, sizeof(flac_decoder));
+    if(d == NULL)
+    {
+        fprintf(stderr, "flac_open_stream: calloc failed\n");
+        fclose(stream);
+
+        return -1;
+    }
+    d->stream = stream;
+
+    if(flac_metadata(d) == -1)
+    {
+        flac_close(d);
+
+        return -1;
+    }
+
+    if(d->channels != 1 || d->bits_per_sample != 16 || d->max_block_size < 16)
+    {
+        fprintf(stderr, "flac_open_stream: only 16 bit mono is supported\n");
+        flac_close(d);
+
+        return -1;
+    }
+
+    d->samples = malloc(d->max_block_size * sizeof(int32_t));
+    d->pcm = malloc(d->max_block_size * sizeof(int16_t));
+    decoded = NULL;
+    if(d->samples == NULL || d->pcm == NULL ||
+       (decoded = fopencookie(d, "r", io)) == NULL)
+    {
+        fprintf(stderr, "flac_open_stream: failed to set up decoder\n");
+        flac_close(d);
+
+        return -1;
+    }
+
+    wav_open_raw(decoded, d->sample_rate, w);
+    w->data_offset = 0;
+    if(d->total_samples != 0 && d->total_samples < INT32_MAX / sizeof(int16_t))
+        w->data.size = d->total_samples * sizeof(int16_t);
+
+    return 0;
+}
+
@@ -0,0 +1,12 @@
+#ifndef __FLAC_H__
+#define __FLAC_H__
+
+#include <stdio.h>
+
+#include "wav.h"
+
+
+int flac_open_stream(FILE *stream, wav_file *w);
+
+#endif
+
@@ -28,30 +28,95 @@
 #include <libgen.h>
 #include <errno.h>
 #include <sys/stat.h>
+#include <sys/statvfs.h>
+#include <sys/time.h>
 #include <time.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <getopt.h>
 #include <signal.h>
 #include <curses.h>
 #include <term.h>
 #include <limits.h>
+#include <endian.h>
+#include <fcntl.h>
 
 #include "riff.h"
 #include "wav.h"
+#include "segment.h"
+#include "net.h"
+#include "zerocopy.h"
+#include "spill.h"
+#include "catalog.h"
+#include "capture.h"
 
 
 char *current_dir;
-char *input;
+char **inputs;
+int input_count;
 char *output;
 char *recording_append;
 double threshold;
 double runlength;
 double short_filter;
 time_t time_start;
+int time_start_mtime;
+char *time_name_format;
+int jobs;
+int raw_rate;
+int jitter_depth;
+int splice_input;
+int clip_stats_enabled;
+int vad_enabled;
 double slice_divisor;
+double window_length;
+double window_hop;
+int detect_rate;
+double compact_length;
+double compact_gap;
+char *config_path;
+double spill_length;
+double range_begin;
+double range_end;
+double rolling_length;
+char *catalog_path;
+catalog clip_catalog;
+double min_free;
+int full_policy;
+
+/* what to do when output file system gets low on space */
+#define FULL_PAUSE 0 /* hold output in memory until there is space */
+#define FULL_DELETE 1 /* remove oldest finished clips */
+#define FULL_DEGRADE 2 /* write new clips as 8 bit */
 
 int terminate_signal;
+volatile sig_atomic_t reload_signal; /* bumped for each SIGHUP */
+int reload_generation; /* reload_signal value config was last read for */
+int reload_result;
+char *loaded_output; /* output and append strings from config file */
+char *loaded_append;
+/* settings can change while jobs run, hold when reading or changing them */
+pthread_mutex_t config_mutex = PTHREAD_MUTEX_INITIALIZER;
 char *clear_line;
 
+struct lurk_job
+{
+    char *input; /* NULL = stdin */
+    int verbose; /* settings and status line, only when splitting one input */
+    int result;
+};
+
+typedef struct lurk_job lurk_job;
+
+lurk_job *job_list;
+int job_next;
+pthread_mutex_t job_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* clips finished by this run, oldest first, for FULL_DELETE */
+char **finished;
+int finished_count;
+pthread_mutex_t finished_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 
 /* mkdir, full path edition */
 int mkdirp(char *path)
@@ -63,115 +128,1502 @@ int mkdirp(char *path)
     if(s == NULL)
         return -1;
 
-    d = dirname(s);
-    if(strcmp(d, ".") == 0 || strcmp(d, "/") == 0)
-        result = 0;
-    else
+    d = dirname(s);
+    if(strcmp(d, ".") == 0 || strcmp(d, "/") == 0)
+        result = 0;
+    else
+    {
+        result = mkdirp(d);
+        if(result == 0)
+        {
+            /* ok if mkdir succeeds or directory already exists */
+            if(mkdir(path, 0777) == 0 || errno == EEXIST)
+                result = 0;
+            else
+                result = -1;
+        }
+    }
+    
+    free(s);
+    
+    return result;
+}
+
+/* use terminfo database to generate a string that clears current line and move
+ * cursor to left side of screen */
+char *generate_clear_line_string()
+{
+    char *s, *m, *c;
+    
+    /* init terminal type */
+    if(setupterm(NULL, STDOUT_FILENO, NULL) == ERR)
+        return NULL;
+    /* carriage return, cursor to left of screen */
+    m = tigetstr("cr");
+    if(m == NULL)
+        return NULL;
+    /* clear from cursor to end of line */
+    c = tigetstr("el");
+    if(c == NULL)
+        return NULL;
+    /* concatinate */
+    if(asprintf(&s, "%s%s", m, c) == -1)
+        return NULL;
+
+    return s;
+}
+
+void message(char *format, ...)
+{
+    char *s;
+    char b[256];
+    va_list args;
+    time_t t;
+    struct tm tm;
+   
+    t = time(NULL);
+    strftime(b, sizeof(b), "%H:%M:%S", localtime_r(&t, &tm));
+    
+    va_start(args, format);
+    if(vasprintf(&s, format, args) == -1)
+        s = NULL;
+    va_end(args);
+
+    if(s == NULL)
+        fprintf(stderr, "message: vasprintf failed\n");
+    else
+    {
+        printf("%s%s %s", clear_line, b, s);
+	free(s);
+    }
+}
+
+void signal_handler(int number)
+{
+    terminate_signal = 1;
+}
+
+void reload_handler(int number)
+{
+    reload_signal++;
+}
+
+/* activity in rolling mode, offsets in stream */
+struct rolling_marker
+{
+    uint64_t start;
+    uint64_t end;
+    int open; /* still going on, end is not known */
+    char *label; /* NULL = "activity" */
+};
+
+typedef struct rolling_marker rolling_marker;
+
+struct clip_output
+{
+    segmenter *segmenter;
+    riff_sub_chunk_wave_format format; /* input format, clips use the same */
+    time_t time_start;
+    uint64_t input_offset; /* samples skipped at start of input */
+    uint64_t start; /* stream offset of clip start */
+    uint64_t end; /* rolling, stream offset where segment ends, 0 = none open */
+    rolling_marker *markers; /* rolling, activity not yet put in a segment */
+    int marker_count;
+    int64_t start_time; /* milliseconds since epoch, for catalog */
+    int32_t peak; /* largest absolute sample */
+    wav_file out;
+    char *path;
+    char *temp_path;
+    char *offsets_path;
+    FILE *offsets;
+    zerocopy *zerocopy; /* move audio from input pipe instead of writing */
+    uint64_t dropped_start; /* input dropped by capture, must not be moved */
+    uint64_t dropped_end;
+    spill spill; /* output waiting for the file system */
+    uint8_t *block; /* output converted to clip format */
+    uint64_t file_size; /* bytes of audio in file */
+    uint64_t lost_total; /* samples lost in clip, segmenter counts them as written */
+    uint64_t lost_position; /* current run of lost samples */
+    uint64_t lost_offset;
+    uint64_t lost_length;
+    int space_check; /* samples until next free space check */
+    int paused;
+};
+
+typedef struct clip_output clip_output;
+
+void clip_free_paths(clip_output *c)
+{
+    if(c->offsets != NULL)
+        fclose(c->offsets);
+    free(c->path);
+    free(c->temp_path);
+    free(c->offsets_path);
+    c->offsets = NULL;
+    c->path = NULL;
+    c->temp_path = NULL;
+    c->offsets_path = NULL;
+}
+
+/* less then min_free MB left on file system of path */
+int space_low(char *path)
+{
+    struct statvfs st;
+
+    if(min_free == 0 || statvfs(path, &st) == -1)
+        return 0;
+
+    return (double)st.f_bavail * st.f_frsize < min_free * 1024 * 1024;
+}
+
+/* remove oldest clip finished by this run, returns -1 if there is none */
+int clip_delete_oldest()
+{
+    char *path, *offsets;
+
+    pthread_mutex_lock(&finished_mutex);
+    if(finished_count == 0)
+    {
+        pthread_mutex_unlock(&finished_mutex);
+
+        return -1;
+    }
+    path = finished[0];
+    finished_count--;
+    memmove(finished, finished + 1, finished_count * sizeof(char *));
+    pthread_mutex_unlock(&finished_mutex);
+
+    if(unlink(path) == -1)
+        fprintf(stderr, "clip_delete_oldest: failed to unlink %s\n", path);
+    else
+        message("Removed %s to free space\n", path);
+    if(asprintf(&offsets, "%s.offsets", path) != -1)
+    {
+        unlink(offsets); /* usually not there */
+        free(offsets);
+    }
+    free(path);
+
+    return 0;
+}
+
+/* make room if policy says so, true if still low on space */
+int make_space(char *path)
+{
+    while(space_low(path))
+        if(full_policy != FULL_DELETE || clip_delete_oldest() == -1)
+            return 1;
+
+    return 0;
+}
+
+/* use name, or name with -1, -2, ... before the extension if a clip with
+ * that name is already there or being recorded, eg by another job. the temp
+ * file is created before looking for the clip so a clip renamed in between
+ * is still seen */
+int clip_name(clip_output *c, char *name, char *append)
+{
+    char *slash, *dot;
+    int n, fd, base;
+
+    slash = strrchr(name, '/');
+    dot = strrchr(name, '.');
+    if(dot == NULL || (slash != NULL && dot < slash))
+        base = strlen(name);
+    else
+        base = dot - name;
+
+    for(n = 0; n < 1000; n++)
+    {
+        if(n == 0)
+            c->path = strdup(name);
+        else if(asprintf(&c->path, "%.*s-%d%s", base, name, n, name + base) == -1)
+            c->path = NULL;
+        if(c->path == NULL)
+            return -1;
+        if(asprintf(&c->temp_path, "%s%s", c->path, append) == -1)
+        {
+            c->temp_path = NULL;
+            clip_free_paths(c);
+
+            return -1;
+        }
+
+        fd = open(c->temp_path, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if(fd != -1)
+        {
+            close(fd);
+            if(access(c->path, F_OK) == -1 && errno == ENOENT)
+                return 0;
+            unlink(c->temp_path);
+        }
+        else if(errno != EEXIST)
+        {
+            fprintf(stderr, "clip_name: open failed: %s: %s\n", c->temp_path, strerror(errno));
+            clip_free_paths(c);
+
+            return -1;
+        }
+
+        clip_free_paths(c);
+    }
+
+    fprintf(stderr, "clip_name: no free name for %s\n", name);
+
+    return -1;
+}
+
+int clip_start(void *user, uint64_t offset)
+{
+    clip_output *c = user;
+    time_t t;
+    struct tm tm;
+    char *s, *d, *name, *append;
+    char expanded[PATH_MAX];
+    int relative;
+
+    c->start = offset;
+    c->peak = 0;
+
+    /* fancy print output path (non-absolute path etc) */
+    if(c->time_start != 0)
+    {
+        t = c->time_start + (c->input_offset + offset) / c->format.sample_rate;
+        c->start_time = (int64_t)c->time_start * 1000 +
+                        (c->input_offset + offset) * 1000 / c->format.sample_rate;
+    }
+    else
+    {
+        struct timeval tv;
+
+        gettimeofday(&tv, NULL);
+        t = tv.tv_sec;
+        c->start_time = (int64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+    }
+
+    pthread_mutex_lock(&config_mutex);
+    strftime(expanded, sizeof(expanded), output, localtime_r(&t, &tm));
+    if(asprintf(&name, "%s%s",
+                (output[0] == '/' ? "" : current_dir), /* make absolute if relative */
+                expanded
+                ) == -1)
+        name = NULL;
+    relative = (output[0] == '/' ? 0 : strlen(current_dir));
+    /* a reload frees the old one */
+    append = strdup(recording_append);
+    pthread_mutex_unlock(&config_mutex);
+
+    if(name == NULL || append == NULL)
+    {
+        fprintf(stderr, "clip_start: asprintf failed: path\n");
+        free(name);
+        free(append);
+
+        return -1;
+    }
+
+    s = strdup(name);
+    if(s == NULL)
+    {
+        fprintf(stderr, "clip_start: strdup failed: path\n");
+        free(name);
+        free(append);
+
+        return -1;
+    }
+    d = dirname(s);
+    if(mkdirp(d) == -1 || clip_name(c, name, append) == -1)
+    {
+        fprintf(stderr, "clip_start: failed to create %s in %s\n", expanded, d);
+        free(s);
+        free(name);
+        free(append);
+        message("Clip is lost\n");
+        c->out.stream = NULL;
+
+        return 0; /* keep lurking, maybe next one works */
+    }
+    free(name);
+    free(append);
+
+    message("Recording started to %s\n", c->path + relative);
+
+    if(asprintf(&c->offsets_path, "%s.offsets", c->path) == -1)
+    {
+        fprintf(stderr, "clip_start: asprintf failed: offsets_path\n");
+        free(s);
+
+        return -1;
+    }
+
+    c->out.format.bits_per_sample = c->format.bits_per_sample;
+    if(make_space(d) && full_policy == FULL_DEGRADE)
+    {
+        message("Low on space, recording as 8 bit\n");
+        c->out.format.bits_per_sample = 8;
+    }
+    free(s);
+
+    c->out.riff.size = INT32_MAX; /* as big as possible, wav_close_write will fix them */
+    c->out.data.size = INT32_MAX;
+    c->out.format.audio_format = 1; /* PCM */
+    c->out.format.num_channels = 1; /* mono */
+    c->out.format.sample_rate = c->format.sample_rate;
+    c->out.format.block_align = c->out.format.bits_per_sample / 8;
+    c->out.format.byte_rate = c->format.sample_rate * c->out.format.block_align;
+
+    /* audio is written to the file descriptor, header must be out first */
+    if(wav_open_write(c->temp_path, &c->out) == -1 || fflush(c->out.stream) == EOF)
+    {
+        fprintf(stderr, "clip_start: failed to open temp output file %s\n", c->temp_path);
+        if(c->out.stream != NULL)
+        {
+            fclose(c->out.stream);
+            unlink(c->temp_path);
+        }
+        message("Clip is lost\n");
+        c->out.stream = NULL;
+
+        return 0;
+    }
+
+    spill_truncate(&c->spill, 0);
+    c->file_size = 0;
+    c->lost_total = 0;
+    c->lost_length = 0;
+    c->space_check = 0;
+    c->paused = 0;
+
+    return 0;
+}
+
+/* write line to offsets file, position is in output and offset in original
+ * audio counted from clip start */
+void clip_offsets(clip_output *c, uint64_t position, uint64_t offset, uint64_t length)
+{
+    if(c->offsets == NULL)
+    {
+        c->offsets = fopen(c->offsets_path, "w");
+        if(c->offsets == NULL)
+        {
+            /* not worth losing audio over */
+            fprintf(stderr, "clip_offsets: failed to open offsets file %s\n", c->offsets_path);
+
+            return;
+        }
+        fprintf(c->offsets, "# output_sample original_sample removed_samples\n");
+    }
+
+    fprintf(c->offsets, "%llu %llu %llu\n",
+            (unsigned long long)position,
+            (unsigned long long)offset,
+            (unsigned long long)length
+            );
+}
+
+/* samples that did not fit in spill, the gap is noted in the offsets file
+ * when output works again so original times can still be found */
+void clip_lost(clip_output *c, uint64_t offset, uint64_t length)
+{
+    if(c->lost_length == 0)
+    {
+        c->lost_position = (c->file_size + c->spill.used) / c->out.format.block_align;
+        c->lost_offset = offset;
+    }
+    c->lost_length += length;
+    c->lost_total += length;
+}
+
+void clip_lost_end(clip_output *c)
+{
+    if(c->lost_length == 0)
+        return;
+
+    clip_offsets(c, c->lost_position, c->lost_offset, c->lost_length);
+    message("Lost %.1f seconds of audio, output was not keeping up\n",
+            (double)c->lost_length / c->format.sample_rate);
+    c->lost_length = 0;
+}
+
+/* samples as little endian 16 bit, or 8 bit unsigned, in c->block. returns
+ * number of bytes */
+int clip_format(clip_output *c, int16_t *buffer, int length)
+{
+    int i;
+
+    if(c->out.format.bits_per_sample == 8)
+        for(i = 0; i < length; i++)
+            c->block[i] = (buffer[i] >> 8) + 128;
+    else
+        for(i = 0; i < length; i++)
+            ((int16_t *)c->block)[i] = htole16(buffer[i]);
+
+    return length * c->out.format.block_align;
+}
+
+/* check free space once a second, output is paused while low on space unless
+ * policy is to write smaller clips */
+void clip_check_space(clip_output *c, int length)
+{
+    int paused;
+
+    c->space_check -= length;
+    if(c->space_check > 0)
+        return;
+    c->space_check = c->format.sample_rate;
+
+    paused = (make_space(c->temp_path) && full_policy != FULL_DEGRADE);
+    if(paused != c->paused)
+        message(paused ? "Low on space, holding output\n" : "Space again, resuming output\n");
+    c->paused = paused;
+}
+
+/* add audio that is at position in the stream to the clip. never fails, if
+ * the file system is full or stalls output is kept in spill and what does not
+ * fit is lost */
+void clip_append(clip_output *c, int16_t *buffer, int length, uint64_t position)
+{
+    uint64_t offset;
+    int fd, bytes, n, i;
+
+    if(c->out.stream == NULL)
+        return; /* clip could not be created */
+
+    for(i = 0; i < length; i++)
+        if(abs(buffer[i]) > c->peak)
+            c->peak = abs(buffer[i]);
+
+    fd = fileno(c->out.stream);
+    offset = position - c->start;
+    bytes = 0;
+    n = 0;
+
+    clip_check_space(c, length);
+    if(c->paused == 0)
+        c->file_size += spill_flush(&c->spill, fd);
+
+    /* older output must go first */
+    if(c->paused == 0 && c->spill.used == 0)
+    {
+        clip_lost_end(c);
+
+        /* buffer is only a copy, move the same part of the input. dropped
+         * input is silence in the copy and input that did not fit in hold
+         * is not there, both are written from the copy */
+        if(c->zerocopy != NULL && c->out.format.bits_per_sample == 16 &&
+           (position >= c->dropped_end || position + length <= c->dropped_start))
+        {
+            if(zerocopy_write(c->zerocopy, fd,
+                              position * sizeof(int16_t),
+                              length * sizeof(int16_t)
+                              ) == 0)
+            {
+                c->file_size += length * sizeof(int16_t);
+
+                return;
+            }
+
+            /* some of it might be there, cut back to what we know */
+            wav_truncate(&c->out, c->file_size);
+        }
+
+        bytes = clip_format(c, buffer, length);
+        n = spill_write(fd, c->block, bytes);
+        c->file_size += n;
+        if(n == bytes)
+            return;
+
+        /* cut off part of a sample so spill stays aligned */
+        if(n % c->out.format.block_align != 0)
+        {
+            c->file_size -= n % c->out.format.block_align;
+            n -= n % c->out.format.block_align;
+            wav_truncate(&c->out, c->file_size);
+        }
+
+        if(c->spill.size > 0)
+            message("Output is not keeping up, holding it in memory\n");
+    }
+
+    if(bytes == 0)
+        bytes = clip_format(c, buffer, length);
+    n += spill_add(&c->spill, c->block + n, bytes - n);
+    if(n < bytes)
+        clip_lost(c,
+                  offset + n / c->out.format.block_align,
+                  (bytes - n) / c->out.format.block_align
+                  );
+}
+
+int clip_write(void *user, int16_t *buffer, int length)
+{
+    clip_output *c = user;
+
+    clip_append(c, buffer, length, c->segmenter->write_offset);
+
+    return 0;
+}
+
+int clip_truncate(void *user, uint64_t length)
+{
+    clip_output *c = user;
+    uint64_t size, start, cut;
+
+    if(c->out.stream == NULL)
+        return 0;
+
+    /* lengths from segmenter include lost samples, first cut the current
+     * run of them if it is at the end */
+    start = c->lost_position + c->lost_total - c->lost_length;
+    cut = (length > start ? length - start : 0);
+    if(cut < c->lost_length)
+    {
+        c->lost_total -= c->lost_length - cut;
+        c->lost_length = cut;
+    }
+    length = (length > c->lost_total ? length - c->lost_total : 0);
+    size = length * c->out.format.block_align;
+    if(size >= c->file_size)
+        spill_truncate(&c->spill, size - c->file_size);
+    else
+    {
+        spill_truncate(&c->spill, 0);
+        wav_truncate(&c->out, size);
+        c->file_size = size;
+    }
+
+    return 0;
+}
+
+int clip_compact(void *user, uint64_t position, uint64_t offset, uint64_t length)
+{
+    clip_output *c = user;
+
+    if(c->out.stream != NULL)
+        clip_offsets(c,
+                     (position > c->lost_total ? position - c->lost_total : 0),
+                     offset,
+                     length
+                     );
+
+    return 0;
+}
+
+/* last chance for held output, then close with chunks after the audio and
+ * move in place, or remove it if keep is 0. length is duration in original
+ * audio */
+void clip_close(clip_output *c, uint64_t length, riff_buffer *chunks, int keep)
+{
+    int n;
+
+    if(c->paused == 0)
+        c->file_size += spill_flush(&c->spill, fileno(c->out.stream));
+    if(c->spill.used > 0)
+    {
+        /* what is left is lost */
+        n = (c->spill.used + c->file_size % c->out.format.block_align) / c->out.format.block_align;
+        c->file_size -= c->file_size % c->out.format.block_align;
+        wav_truncate(&c->out, c->file_size);
+        spill_truncate(&c->spill, 0);
+        if(c->lost_length == 0)
+            c->lost_offset = length;
+        c->lost_position = c->file_size / c->out.format.block_align;
+        c->lost_offset -= n;
+        c->lost_length += n;
+        c->lost_total += n;
+    }
+    clip_lost_end(c);
+
+    if(wav_close_write_chunks(&c->out, chunks->data, chunks->size) == -1)
+        fprintf(stderr, "clip_close: failed to close output file %s\n", c->temp_path);
+
+    if(keep == 0)
+    {
+        if(unlink(c->temp_path) == -1)
+            fprintf(stderr, "clip_close: faild to unlink %s\n", c->temp_path);
+        if(c->offsets != NULL && unlink(c->offsets_path) == -1)
+            fprintf(stderr, "clip_close: faild to unlink %s\n", c->offsets_path);
+    }
+    else if(rename(c->temp_path, c->path) == -1)
+        fprintf(stderr, "clip_close: faild to rename %s to %s\n", c->temp_path, c->path);
+    else
+    {
+        if(catalog_path != NULL)
+        {
+            catalog_record r;
+
+            memset(&r, 0, sizeof(r));
+            r.start = c->start_time;
+            r.end = c->start_time + length * 1000 / c->format.sample_rate;
+            r.offset = c->input_offset + c->start;
+            r.sample_rate = c->format.sample_rate;
+            r.peak = c->peak;
+            if(catalog_add(&clip_catalog, &r, c->path) == -1)
+                fprintf(stderr, "clip_close: failed to add %s to catalog\n", c->path);
+        }
+
+        if(full_policy == FULL_DELETE)
+        {
+            char **t;
+
+            pthread_mutex_lock(&finished_mutex);
+            t = realloc(finished, (finished_count + 1) * sizeof(char *));
+            if(t != NULL)
+            {
+                finished = t;
+                finished[finished_count++] = c->path;
+                c->path = NULL; /* kept in list */
+            }
+            pthread_mutex_unlock(&finished_mutex);
+        }
+    }
+}
+
+int clip_stop(void *user, uint64_t offset, uint64_t length, int keep)
+{
+    clip_output *c = user;
+    char text[256];
+    riff_buffer info = {NULL, 0}, list = {NULL, 0};
+
+    if(c->out.stream == NULL)
+    {
+        clip_free_paths(c);
+
+        return 0;
+    }
+
+    if(clip_stats_enabled)
+    {
+        /* LIST INFO chunk with stats as comment */
+        stats_format(&c->segmenter->stats.clip, text, sizeof(text));
+        if(riff_buffer_add(&info, "INFO", 4) == -1 ||
+           riff_buffer_add_chunk(&info, "ICMT", text, strlen(text) + 1) == -1 ||
+           riff_buffer_add_chunk(&list, "LIST", info.data, info.size) == -1)
+        {
+            fprintf(stderr, "clip_stop: failed to make LIST chunk\n");
+            /* never write a partial chunk */
+            riff_buffer_free(&info);
+            riff_buffer_free(&list);
+        }
+    }
+    clip_close(c, length, &list, keep);
+    riff_buffer_free(&info);
+    riff_buffer_free(&list);
+
+    if(keep == 0)
+        message("Recording removed, short filter\n");
+    else
+    {
+        message("Recording stopped, %d minutes %d seconds recorded\n",
+                (int)(length / c->format.sample_rate) / 60,
+                (int)(length / c->format.sample_rate) % 60
+                );
+        if(clip_stats_enabled)
+            message("Stats, %s\n", text);
+        if(c->segmenter->removed_total != 0)
+            message("Compacted, %d seconds of silence removed\n",
+                    (int)(c->segmenter->removed_total / c->format.sample_rate)
+                    );
+    }
+
+    clip_free_paths(c);
+
+    return 0;
+}
+
+/* cue points for activity in the segment, with a labl and an ltxt with the
+ * length of each in a LIST adtl chunk */
+void rolling_chunks(clip_output *c, uint64_t end, riff_buffer *chunks)
+{
+    riff_buffer points = {NULL, 0}, adtl = {NULL, 0}, labl = {NULL, 0};
+    rolling_marker *m;
+    uint32_t point[6], ltxt[5], count, id;
+    uint64_t start, stop;
+    char text[300];
+    int i;
+
+    count = 0;
+    if(riff_buffer_add(&points, &count, sizeof(count)) == -1 ||
+       riff_buffer_add(&adtl, "adtl", 4) == -1)
+        goto fail;
+
+    for(i = 0; i < c->marker_count; i++)
+    {
+        m = &c->markers[i];
+        start = (m->start > c->start ? m->start : c->start);
+        stop = (m->open || m->end > end ? end : m->end);
+        if(start >= end || stop <= start)
+            continue;
+
+        count++;
+        id = htole32(count);
+        point[0] = id;
+        point[1] = htole32(start - c->start); /* play order position */
+        memcpy(&point[2], "data", 4);
+        point[3] = 0; /* chunk start */
+        point[4] = 0; /* block start */
+        point[5] = htole32(start - c->start);
+
+        /* region length, purpose and country, language, dialect, code page */
+        ltxt[0] = id;
+        ltxt[1] = htole32(stop - start);
+        memcpy(&ltxt[2], "rgn ", 4);
+        ltxt[3] = 0;
+        ltxt[4] = 0;
+
+        snprintf(text, sizeof(text), "%s%s%s",
+                 (m->start < c->start ? "continued " : ""),
+                 (m->label == NULL ? "activity" : m->label),
+                 (m->open || m->end > end ? " continues" : ""));
+        labl.size = 0;
+        if(riff_buffer_add(&points, point, sizeof(point)) == -1 ||
+           riff_buffer_add(&labl, &id, sizeof(id)) == -1 ||
+           riff_buffer_add(&labl, text, strlen(text) + 1) == -1 ||
+           riff_buffer_add_chunk(&adtl, "labl", labl.data, labl.size) == -1 ||
+           riff_buffer_add_chunk(&adtl, "ltxt", ltxt, sizeof(ltxt)) == -1)
+            goto fail;
+    }
+
+    if(count > 0)
+    {
+        count = htole32(count);
+        memcpy(points.data, &count, sizeof(count));
+        if(riff_buffer_add_chunk(chunks, "cue ", points.data, points.size) == -1 ||
+           riff_buffer_add_chunk(chunks, "LIST", adtl.data, adtl.size) == -1)
+            goto fail;
+    }
+
+    riff_buffer_free(&points);
+    riff_buffer_free(&adtl);
+    riff_buffer_free(&labl);
+
+    return;
+
+fail:
+    fprintf(stderr, "rolling_chunks: failed to make cue chunks\n");
+    riff_buffer_free(&points);
+    riff_buffer_free(&adtl);
+    riff_buffer_free(&labl);
+    riff_buffer_free(chunks);
+}
+
+/* close current segment at end, activity that is over is forgotten */
+void rolling_close(clip_output *c, uint64_t end)
+{
+    riff_buffer chunks = {NULL, 0};
+    int i, n;
+
+    if(c->out.stream != NULL)
+    {
+        rolling_chunks(c, end, &chunks);
+        clip_close(c, end - c->start, &chunks, 1);
+        riff_buffer_free(&chunks);
+        message("Segment done, %d minutes %d seconds recorded\n",
+                (int)((end - c->start) / c->format.sample_rate) / 60,
+                (int)((end - c->start) / c->format.sample_rate) % 60
+                );
+    }
+    clip_free_paths(c);
+    c->end = 0;
+
+    for(i = 0, n = 0; i < c->marker_count; i++)
+        if(c->markers[i].open || c->markers[i].end > end)
+            c->markers[n++] = c->markers[i];
+        else
+            free(c->markers[i].label);
+    c->marker_count = n;
+}
+
+/* all audio goes to segment files of rolling_length seconds, a new one is
+ * started when the current is full */
+void rolling_append(clip_output *c, int16_t *buffer, int length, uint64_t position)
+{
+    uint64_t n;
+
+    while(length > 0)
+    {
+        if(c->end != 0 && position >= c->end)
+            rolling_close(c, c->end);
+        if(c->end == 0)
+        {
+            clip_start(c, position);
+            c->end = position + (uint64_t)(rolling_length * c->format.sample_rate);
+            if(c->end <= position)
+                c->end = position + 1;
+        }
+
+        n = c->end - position;
+        if(n > length)
+            n = length;
+        clip_append(c, buffer, n, position);
+        buffer += n;
+        length -= n;
+        position += n;
+    }
+}
+
+void rolling_free(clip_output *c)
+{
+    int i;
+
+    for(i = 0; i < c->marker_count; i++)
+        free(c->markers[i].label);
+    free(c->markers);
+    c->markers = NULL;
+    c->marker_count = 0;
+}
+
+/* segmenter callbacks in rolling mode, activity only becomes markers */
+int rolling_start(void *user, uint64_t offset)
+{
+    clip_output *c = user;
+    rolling_marker *t;
+
+    t = realloc(c->markers, (c->marker_count + 1) * sizeof(rolling_marker));
+    if(t == NULL)
+    {
+        fprintf(stderr, "rolling_start: realloc failed\n");
+
+        return -1;
+    }
+    c->markers = t;
+    t = &c->markers[c->marker_count++];
+    t->start = offset;
+    t->end = offset;
+    t->open = 1;
+    t->label = NULL;
+
+    message("Activity started\n");
+
+    return 0;
+}
+
+int rolling_write(void *user, int16_t *buffer, int length)
+{
+    return 0; /* audio is written by rolling_append */
+}
+
+int rolling_truncate(void *user, uint64_t length)
+{
+    return 0;
+}
+
+int rolling_stop(void *user, uint64_t offset, uint64_t length, int keep)
+{
+    clip_output *c = user;
+    rolling_marker *m;
+    char text[256];
+
+    /* only the last one can be open */
+    m = &c->markers[c->marker_count - 1];
+
+    if(keep == 0)
+    {
+        c->marker_count--;
+        message("Activity removed, short filter\n");
+
+        return 0;
+    }
+
+    m->open = 0;
+    m->end = offset + length;
+    if(clip_stats_enabled)
+    {
+        stats_format(&c->segmenter->stats.clip, text, sizeof(text));
+        m->label = strdup(text);
+        message("Stats, %s\n", text);
+    }
+
+    message("Activity stopped, %d minutes %d seconds\n",
+            (int)(length / c->format.sample_rate) / 60,
+            (int)(length / c->format.sample_rate) % 60
+            );
+
+    return 0;
+}
+
+/* input that does not wait for us, anything but a file */
+int input_live(char *input)
+{
+    struct stat st;
+
+    if(input == NULL)
+        return fstat(STDIN_FILENO, &st) == -1 || !S_ISREG(st.st_mode);
+    if(net_is_uri(input))
+        return 1;
+
+    return stat(input, &st) == -1 || !S_ISREG(st.st_mode);
+}
+
+/* start time of a file in batch mode, from file name or modification time
+ * minus audio length. falls back to -s */
+time_t input_start_time(char *path, wav_file *in)
+{
+    struct tm t;
+    struct stat st;
+    char *s, *name;
+    time_t r;
+
+    r = time_start;
+
+    if(time_name_format != NULL)
+    {
+        s = strdup(path);
+        if(s == NULL)
+            return r;
+        name = basename(s);
+        memset(&t, 0, sizeof(t));
+        t.tm_isdst = -1;
+        if(strptime(name, time_name_format, &t) != NULL)
+            r = mktime(&t);
+        else
+            fprintf(stderr, "input_start_time: %s does not match %s\n", name, time_name_format);
+        free(s);
+    }
+    else if(time_start_mtime == 1 && stat(path, &st) == 0)
+        r = st.st_mtime - (in->format.byte_rate > 0 ? in->data.size / in->format.byte_rate : 0);
+
+    return r;
+}
+
+int input_filter(const struct dirent *d)
+{
+    int l = strlen(d->d_name), r;
+
+    /* skip hidden files and clips that are still being recorded */
+    pthread_mutex_lock(&config_mutex);
+    r = (d->d_name[0] != '.' &&
+         ((l > 4 && strcmp(d->d_name + l - 4, ".wav") == 0) ||
+          (l > 5 && strcmp(d->d_name + l - 5, ".flac") == 0)) &&
+         !(l > strlen(recording_append) &&
+           strcmp(d->d_name + l - strlen(recording_append), recording_append) == 0));
+    pthread_mutex_unlock(&config_mutex);
+
+    return r;
+}
+
+/* add input file, or all wav files in it if it is a directory */
+int add_input(char *path)
+{
+    struct stat st;
+    struct dirent **names;
+    char **t;
+    int i, n;
+
+    if(stat(path, &st) == 0 && S_ISDIR(st.st_mode))
+    {
+        n = scandir(path, &names, input_filter, alphasort);
+        if(n == -1)
+        {
+            fprintf(stderr, "add_input: scandir %s failed\n", path);
+
+            return -1;
+        }
+
+        for(i = 0; i < n; i++)
+        {
+            char *s;
+
+            if(asprintf(&s, "%s/%s", path, names[i]->d_name) == -1 || add_input(s) == -1)
+                return -1;
+            free(names[i]);
+        }
+        free(names);
+
+        return 0;
+    }
+
+    t = realloc(inputs, (input_count + 1) * sizeof(char *));
+    if(t == NULL)
+    {
+        fprintf(stderr, "add_input: realloc failed\n");
+
+        return -1;
+    }
+    inputs = t;
+    inputs[input_count++] = path;
+
+    return 0;
+}
+
+/* "YYYY-MM-DD HH:MM:SS" in local time */
+int parse_time(char *value, time_t *r)
+{
+    struct tm t;
+    char *s;
+
+    memset(&t, 0, sizeof(t));
+    t.tm_isdst = -1; /* strptime leaves it, let mktime find out */
+    s = strptime(value, "%Y-%m-%d %H:%M:%S", &t);
+    if(s == NULL || *s != '\0')
+    {
+        fprintf(stderr, "Invalid time format\n");
+
+        return -1;
+    }
+
+    *r = mktime(&t);
+
+    return 0;
+}
+
+int query_found(void *user, catalog_record *r, char *path)
+{
+    char *pattern = user;
+    char s[64];
+    struct tm tm;
+    time_t t;
+
+    if(pattern != NULL && strstr(path, pattern) == NULL)
+        return 0;
+
+    t = r->start / 1000;
+    strftime(s, sizeof(s), "%Y-%m-%d %H:%M:%S", localtime_r(&t, &tm));
+    printf("%s.%03d %.3f %.1f %s\n",
+           s, (int)(r->start % 1000),
+           (double)(r->end - r->start) / 1000,
+           (r->peak > 0 ? 20 * log10((double)r->peak / INT16_MAX) : -INFINITY),
+           path
+           );
+
+    return 0;
+}
+
+/* lurker query CATALOG FROM TO [TEXT], list clips recorded between FROM and
+ * TO with TEXT in the path */
+int query(int argc, char **argv)
+{
+    time_t from, to;
+
+    if(argc < 5 || argc > 6)
+    {
+        printf("Usage: %s query CATALOG FROM TO [TEXT]\n"
+               "    List clips in CATALOG (see -x) with audio between FROM and TO,\n"
+               "    optionally only those with TEXT in the path.\n"
+               "    Eg: %s query clips.cat \"2000-01-02 14:02:00\" \"2000-01-02 14:10:00\" feed7/\n"
+               "    Prints start time, length in seconds, peak in dBFS and path.\n",
+               argv[0], argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    if(parse_time(argv[3], &from) == -1 || parse_time(argv[4], &to) == -1)
+        return EXIT_FAILURE;
+
+    if(catalog_query(argv[2], (int64_t)from * 1000, (int64_t)to * 1000,
+                     query_found, (argc == 6 ? argv[5] : NULL)) == -1)
+        return EXIT_FAILURE;
+
+    return EXIT_SUCCESS;
+}
+
+struct option options[] =
+{
+    {"help", 0, 0, 'h'},
+    {"input", 1, 0, 'i'},
+    {"output", 1, 0, 'o'},
+    {"append", 1, 0, 'a'},
+    {"threshold", 1, 0, 't'},
+    {"runlength", 1, 0, 'r'},
+    {"filter", 1, 0, 'f'},
+    {"start", 1, 0, 's'},
+    {"divisor", 1, 0, 'd'},
+    {"window", 1, 0, 'w'},
+    {"hop", 1, 0, 'p'},
+    {"detect-rate", 1, 0, 'D'},
+    {"compact", 1, 0, 'c'},
+    {"gap", 1, 0, 'g'},
+    {"jobs", 1, 0, 'j'},
+    {"name-time", 1, 0, 'n'},
+    {"raw", 1, 0, 'R'},
+    {"jitter", 1, 0, 'J'},
+    {"splice", 0, 0, 'Z'},
+    {"stats", 0, 0, 'S'},
+    {"vad", 0, 0, 'V'},
+    {"config", 1, 0, 'C'},
+    {"spill", 1, 0, 'B'},
+    {"min-free", 1, 0, 'm'},
+    {"full", 1, 0, 'F'},
+    {"begin", 1, 0, 'b'},
+    {"end", 1, 0, 'e'},
+    {"rolling", 1, 0, 'l'},
+    {"catalog", 1, 0, 'x'},
+    {NULL, 0, 0, 0}
+};
+
+/* options that can be changed by reloading the config file while running */
+#define RELOAD_OPTIONS "oatrfcg"
+/* options that keep pointing to their value */
+#define STRING_OPTIONS "oainx"
+
+/* set option from command line or config file, string values are kept */
+int set_option(int option, char *value)
+{
+    if(option == 'i')
+        return add_input(value);
+    else if(option == 'o')
+        output = value;
+    else if(option == 'a')
+        recording_append = value;
+    else if(option == 't')
+        threshold = atof(value);
+    else if(option == 'r')
+        runlength = atof(value);
+    else if(option == 'f')
+        short_filter = atof(value);
+    else if(option == 's')
+    {
+        if(strcmp(value, "now") == 0)
+            time_start = time(NULL);
+        else if(strcmp(value, "mtime") == 0)
+            time_start_mtime = 1;
+        else if(parse_time(value, &time_start) == -1)
+            return -1;
+    }
+    else if(option == 'd')
+        slice_divisor = atof(value);
+    else if(option == 'w')
+        window_length = atof(value);
+    else if(option == 'p')
+        window_hop = atof(value);
+    else if(option == 'D')
+        detect_rate = atoi(value);
+    else if(option == 'c')
+        compact_length = atof(value);
+    else if(option == 'g')
+        compact_gap = atof(value);
+    else if(option == 'j')
+        jobs = atoi(value);
+    else if(option == 'n')
+        time_name_format = value;
+    else if(option == 'R')
+        raw_rate = atoi(value);
+    else if(option == 'J')
+        jitter_depth = atoi(value);
+    else if(option == 'Z')
+        splice_input = 1;
+    else if(option == 'S')
+        clip_stats_enabled = 1;
+    else if(option == 'V')
+        vad_enabled = 1;
+    else if(option == 'b')
+        range_begin = atof(value);
+    else if(option == 'e')
+        range_end = atof(value);
+    else if(option == 'l')
+        rolling_length = atof(value);
+    else if(option == 'x')
+        catalog_path = value;
+    else if(option == 'B')
+        spill_length = atof(value);
+    else if(option == 'm')
+        min_free = atof(value);
+    else if(option == 'F')
+    {
+        if(strcmp(value, "pause") == 0)
+            full_policy = FULL_PAUSE;
+        else if(strcmp(value, "delete") == 0)
+            full_policy = FULL_DELETE;
+        else if(strcmp(value, "degrade") == 0)
+            full_policy = FULL_DEGRADE;
+        else
+        {
+            fprintf(stderr, "Invalid full policy, use pause, delete or degrade\n");
+
+            return -1;
+        }
+    }
+    else
+    {
+        fprintf(stderr, "Error in argument: %c\n", option);
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/* copy settings that can change while running, hold config_mutex */
+void config_copy(segment_config *config)
+{
+    config->threshold = threshold;
+    config->runlength = runlength;
+    config->short_filter = short_filter;
+    config->compact_length = compact_length;
+    config->compact_gap = compact_gap;
+}
+
+/* put back settings saved with config_copy and output and append */
+void config_restore(segment_config *config, char *old_output, char *old_append)
+{
+    threshold = config->threshold;
+    runlength = config->runlength;
+    short_filter = config->short_filter;
+    compact_length = config->compact_length;
+    compact_gap = config->compact_gap;
+    output = old_output;
+    recording_append = old_append;
+}
+
+/* rolling files keep all audio, there is nothing to compact */
+int rolling_check_config()
+{
+    if(rolling_length != 0 && compact_length != 0)
+    {
+        fprintf(stderr, "Compact can not be used with rolling files\n");
+
+        return -1;
+    }
+
+    return 0;
+}
+
+/* read options from file, one long option name and value per line, # starts
+ * a comment. when running only RELOAD_OPTIONS can be set, hold config_mutex.
+ * nothing is changed unless the whole file is fine, values are set and
+ * checked together and the old ones put back if they do not work */
+int config_load(char *path, int running)
+{
+    FILE *f;
+    char line[1024];
+    char *name, *value, *e;
+    char *old_output, *old_append, *new_output, *new_append;
+    segment_config old, check;
+    int pass, number, i;
+    int errors = 0;
+
+    f = fopen(path, "r");
+    if(f == NULL)
+    {
+        fprintf(stderr, "config_load: failed to open %s\n", path);
+
+        return -1;
+    }
+
+    config_copy(&old);
+    old_output = output;
+    old_append = recording_append;
+    new_output = NULL;
+    new_append = NULL;
+
+    /* first pass checks, second sets */
+    for(pass = 0; pass < 2 && errors == 0; pass++)
+    {
+        rewind(f);
+        number = 0;
+
+        while(fgets(line, sizeof(line), f) != NULL)
+        {
+            number++;
+
+            name = line + strspn(line, " \t");
+            name[strcspn(name, "#\r\n")] = '\0';
+            if(*name == '\0')
+                continue;
+            /* name and value separated by whitespace or = */
+            value = name + strcspn(name, " \t=");
+            if(*value != '\0')
+            {
+                *value++ = '\0';
+                value += strspn(value, " \t=");
+            }
+            e = value + strlen(value);
+            while(e > value && (e[-1] == ' ' || e[-1] == '\t'))
+                *--e = '\0';
+
+            for(i = 0; options[i].name != NULL; i++)
+                if(strcmp(options[i].name, name) == 0)
+                    break;
+
+            if(pass == 0)
+            {
+                if(options[i].name == NULL || options[i].val == 'h' || options[i].val == 'C')
+                {
+                    fprintf(stderr, "%s:%d: unknown option %s\n", path, number, name);
+                    errors++;
+                }
+                else if(running && strchr(RELOAD_OPTIONS, options[i].val) == NULL)
+                {
+                    fprintf(stderr, "%s:%d: %s can not be changed while running\n", path, number, name);
+                    errors++;
+                }
+                else if(options[i].has_arg && *value == '\0')
+                {
+                    fprintf(stderr, "%s:%d: %s needs a value\n", path, number, name);
+                    errors++;
+                }
+            }
+            else if(strchr(STRING_OPTIONS, options[i].val) != NULL &&
+                    (value = strdup(value)) == NULL)
+                errors++;
+            else
+            {
+                if(set_option(options[i].val, value) == -1)
+                    errors++;
+                /* only the last one is used */
+                if(options[i].val == 'o')
+                {
+                    free(new_output);
+                    new_output = value;
+                }
+                else if(options[i].val == 'a')
+                {
+                    free(new_append);
+                    new_append = value;
+                }
+            }
+        }
+    }
+
+    fclose(f);
+
+    /* command line can still change things at start, lurk checks then */
+    if(errors == 0 && running)
     {
-        result = mkdirp(d);
-        if(result == 0)
+        config_copy(&check);
+        if(segmenter_check_config(&check) == -1 || rolling_check_config() == -1)
+            errors++;
+    }
+
+    if(errors > 0)
+    {
+        if(running)
         {
-            /* ok if mkdir succeeds or directory already exists */
-            if(mkdir(path, 0777) == 0 || errno == EEXIST)
-                result = 0;
-            else
-                result = -1;
+            config_restore(&old, old_output, old_append);
+            free(new_output);
+            free(new_append);
         }
-    }
-    
-    free(s);
-    
-    return result;
-}
 
-/* discrete root mean square algorithm */
-/* http://en.wikipedia.org/wiki/Root_mean_square */
-double root_mean_square(int16_t *buffer, int length)
-{
-    int i;
-    double sum = 0.0;
+        return -1;
+    }
 
-    for(i = 0; i < length; i++)
-        sum += (buffer[i] * buffer[i]) / length;
+    /* strings from an earlier load are no longer used */
+    if(new_output != NULL)
+    {
+        free(loaded_output);
+        loaded_output = new_output;
+    }
+    if(new_append != NULL)
+    {
+        free(loaded_append);
+        loaded_append = new_append;
+    }
 
-    return sqrt(sum) / INT16_MAX;
+    return 0;
 }
 
-/* use terminfo database to generate a string that clears current line and move
- * cursor to left side of screen */
-char *generate_clear_line_string()
+/* called by each job when it sees a new SIGHUP, the first one to get here
+ * rereads the config file. returns -1 if the file was bad, settings are then
+ * left as they were */
+int config_reload(int generation, segment_config *config)
 {
-    char *s, *m, *c;
-    
-    /* init terminal type */
-    if(setupterm(NULL, STDOUT_FILENO, NULL) == ERR)
-        return NULL;
-    /* carriage return, cursor to left of screen */
-    m = tigetstr("cr");
-    if(m == NULL)
-        return NULL;
-    /* clear from cursor to end of line */
-    c = tigetstr("el");
-    if(c == NULL)
-        return NULL;
-    /* concatinate */
-    if(asprintf(&s, "%s%s", m, c) == -1)
-        return NULL;
+    pthread_mutex_lock(&config_mutex);
+    if(reload_generation < generation)
+    {
+        reload_generation = generation;
+        reload_result = config_load(config_path, 1);
+        if(reload_result == -1)
+            message("Failed to reload %s, keeping old settings\n", config_path);
+    }
+    config_copy(config);
+    pthread_mutex_unlock(&config_mutex);
 
-    return s;
+    return reload_result;
 }
 
-void message(char *format, ...)
+/* input capture had to drop while output stalled, the segmenter gets silence
+ * in its place so times stay right. silence is buffer_length zero samples */
+int lurk_lost(segmenter *seg, clip_output *c, int16_t *silence, int buffer_length,
+              uint64_t position, uint64_t length)
 {
-    char *s;
-    char b[256];
-    va_list args;
-    time_t t;
-   
-    t = time(NULL);
-    strftime(b, sizeof(b), "%H:%M:%S", localtime(&t));
-    
-    va_start(args, format);
-    if(vasprintf(&s, format, args) == -1)
-        s = NULL;
-    va_end(args);
+    int n;
 
-    if(s == NULL)
-        fprintf(stderr, "message: vasprintf failed\n");
-    else
+    /* input before what the segmenter still holds is written or gone */
+    if(c->dropped_end <= seg->total_length - seg->preroll_used)
+        c->dropped_start = position;
+    c->dropped_end = position + length;
+
+    while(length > 0)
     {
-        printf("%s%s %s", clear_line, b, s);
-	free(s);
+        n = (length < buffer_length ? length : buffer_length);
+        if(segmenter_push(seg, silence, n) == -1)
+            return -1;
+        if(rolling_length != 0)
+            rolling_append(c, silence, n, position);
+        position += n;
+        length -= n;
     }
-}
 
-void signal_handler(int number)
-{
-    terminate_signal = 1;
+    return 0;
 }
 
-int lurk()
+int lurk(lurk_job *job)
 {
-    wav_file in, out;
-    int quit;
-    int16_t *buffer;
-    int buffer_length, buffer_bytes, read_length;
-    uint64_t total_length, cut_length, peak_length;
-    int recording;
-    char *output_path, *output_temp_path;
-    double rms;
+    char *input = job->input;
+    wav_file in;
+    segmenter seg;
+    segment_config config;
+    segment_callbacks callbacks =
+    {
+        clip_start,
+        clip_write,
+        clip_truncate,
+        clip_compact,
+        clip_stop
+    };
+    segment_callbacks rolling_callbacks =
+    {
+        rolling_start,
+        rolling_write,
+        rolling_truncate,
+        NULL,
+        rolling_stop
+    };
+    clip_output clip;
+    zerocopy zc;
+    capture cap;
+    int16_t *buffer, *silence;
+    int buffer_length, read_length, queue_length, block_length;
+    uint64_t range_length, read_total, lost;
+    int r;
     const char progress[] = {'|', '/', '-', '\\'};
-    uint64_t progress_temp, progress_position;
+    uint64_t progress_position;
+    int seen_reload = reload_signal;
 
-    quit = 0;
-    terminate_signal = 0;
-    output_path = NULL;
-    output_temp_path = NULL;
-    progress_position = 0;
+    r = 0;
     
-    printf("Reading header from %s\n", (input == NULL ? "stdin" : input));
+    if(job->verbose)
+        printf("Reading header from %s\n", (input == NULL ? "stdin" : input));
+
+    if(input != NULL && net_is_uri(input))
+    {
+        if(net_open_read(input, raw_rate, jitter_depth, &in) == -1)
+        {
+            fprintf(stderr, "Failed to open %s for input\n", input);
+
+            return -1;
+        }
+    }
+    else if(raw_rate != 0)
+    {
+        FILE *stream = (input == NULL ? stdin : fopen(input, "r"));
+
+        if(stream == NULL || wav_open_raw(stream, raw_rate, &in) == -1)
+        {
+            fprintf(stderr, "Failed to open %s for input\n", input);
+
+            return -1;
+        }
+    }
+    else if(splice_input && input == NULL &&
+            /* no read ahead, input after header must be left in the pipe */
+            setvbuf(stdin, NULL, _IONBF, 0) != 0)
+    {
+        fprintf(stderr, "Failed to make stdin unbuffered\n");
 
-    if(wav_open_read(input, &in) == -1)
+        return -1;
+    }
+    else if(wav_open_read(input, &in) == -1)
     {
         fprintf(stderr, "Failed to open %s for input\n", input);
 
@@ -183,283 +1635,320 @@ int lurk()
          in.format.num_channels == 1))
     {
         fprintf(stderr, "Wrong audio format, i want 16 bit mono PCM audio\n");
+        wav_close_read(&in);
+
+        return -1;
+    }
+
+    /* only part of input, seek table is used for flac */
+    if(range_begin != 0 && wav_seek(&in, range_begin * in.format.sample_rate) == -1)
+    {
+        fprintf(stderr, "Failed to skip to %g seconds in %s\n", range_begin, (input == NULL ? "stdin" : input));
+        wav_close_read(&in);
 
         return -1;
     }
+    range_length = (range_end > range_begin ? (range_end - range_begin) * in.format.sample_rate : 0);
     
-    printf("Output: %s\n", output);
-    printf("Recording append: %s\n", recording_append);
-    printf("Threshold: %g\n", threshold);
-    printf("Runlength: %g seconds\n", runlength);
-    if(short_filter != 0)
-        printf("Short filter: %g seconds\n", short_filter);
+    if(job->verbose)
+    {
+        if(config_path != NULL)
+            printf("Config: %s (SIGHUP reloads)\n", config_path);
+        pthread_mutex_lock(&config_mutex);
+        printf("Output: %s\n", output);
+        printf("Recording append: %s\n", recording_append);
+        pthread_mutex_unlock(&config_mutex);
+        printf("Threshold: %g\n", threshold);
+        printf("Runlength: %g seconds\n", runlength);
+        if(short_filter != 0)
+            printf("Short filter: %g seconds\n", short_filter);
+        if(compact_length != 0)
+            printf("Compact: silence over %g seconds to %g seconds\n", compact_length, compact_gap);
+        if(range_begin != 0 || range_end != 0)
+            printf("Range: %g to %g seconds\n", range_begin, range_end);
+        if(rolling_length != 0)
+            printf("Rolling: %g second files, activity as cue points\n", rolling_length);
+        if(min_free != 0)
+            printf("Minimum free space: %g MB, %s when low\n", min_free,
+                   (full_policy == FULL_DELETE ? "delete oldest clip" :
+                    full_policy == FULL_DEGRADE ? "record 8 bit" : "pause"));
+    }
+
+    config.sample_rate = in.format.sample_rate;
+    config.slice_divisor = slice_divisor;
+    pthread_mutex_lock(&config_mutex);
+    config_copy(&config);
+    pthread_mutex_unlock(&config_mutex);
+    config.window_length = window_length;
+    config.window_hop = window_hop;
+    config.detect_rate = detect_rate;
+    config.stats = clip_stats_enabled;
+    config.vad = vad_enabled;
+
+    clip.segmenter = &seg;
+    clip.format = in.format;
+    clip.time_start = (input == NULL || net_is_uri(input) ? time_start : input_start_time(input, &in));
+    clip.input_offset = range_begin * in.format.sample_rate;
+    clip.start = 0;
+    clip.end = 0;
+    clip.markers = NULL;
+    clip.marker_count = 0;
+    clip.path = NULL;
+    clip.temp_path = NULL;
+    clip.offsets_path = NULL;
+    clip.offsets = NULL;
+    clip.zerocopy = NULL;
+    clip.dropped_start = 0;
+    clip.dropped_end = 0;
+    clip.out.stream = NULL;
+
+    if(segmenter_init(&seg, &config,
+                      (rolling_length != 0 ? &rolling_callbacks : &callbacks),
+                      &clip) == -1)
+    {
+        fprintf(stderr, "lurk: segmenter_init failed\n");
+        wav_close_read(&in);
+
+        return -1;
+    }
    
-    buffer_length = in.format.sample_rate / slice_divisor;
-    buffer_bytes = buffer_length * in.format.block_align;
-    buffer = malloc(buffer_bytes);
-    if(buffer == NULL)
+    /* read whole slices so the segmenter never has to copy */
+    buffer_length = seg.slice_length;
+    silence = calloc(buffer_length, sizeof(int16_t));
+    clip.block = malloc(buffer_length * in.format.block_align);
+    /* whole samples */
+    if(silence == NULL || clip.block == NULL ||
+       spill_init(&clip.spill, (int)(spill_length * in.format.sample_rate) * in.format.block_align) == -1)
     {
-        fprintf(stderr, "lurk: malloc audio buffer failed\n");
+        fprintf(stderr, "lurk: malloc audio buffers failed\n");
+        free(silence);
+        free(clip.block);
+        segmenter_free(&seg);
+        wav_close_read(&in);
 
         return -1;
     }
-    total_length = 0;
-    cut_length = 0;
-    peak_length = 0;
-    recording = 0;
 
-    if(time_start != 0)
+    /* input read ahead of the segmenter, with -Z it has to fit in the hold
+     * pipe too together with what the segmenter keeps. reads are whole
+     * buffers so the segmenter always gets whole buffers */
+    queue_length = spill_length * in.format.sample_rate;
+    block_length = buffer_length;
+    if(splice_input)
+    {
+        if(input != NULL ||
+           zerocopy_open(fileno(in.stream), buffer_length * sizeof(int16_t),
+                         (queue_length + buffer_length + seg.preroll_length) * sizeof(int16_t),
+                         &zc) == -1)
+            fprintf(stderr, "Can only splice from a stdin pipe, using normal reads\n");
+        else
+        {
+            clip.zerocopy = &zc;
+            queue_length = zc.queue / sizeof(int16_t) - buffer_length - seg.preroll_length;
+            block_length = zc.capacity / sizeof(int16_t);
+        }
+    }
+
+    if(job->verbose)
     {
-        char s[256];
-        
-        strftime(s, sizeof(s), "%Y-%m-%d %H:%M:%S", localtime(&time_start));
-        printf("Start time: %s\n", s);
+        if(clip.time_start != 0)
+        {
+            char s[256];
+            struct tm tm;
+            
+            strftime(s, sizeof(s), "%Y-%m-%d %H:%M:%S", localtime_r(&clip.time_start, &tm));
+            printf("Start time: %s\n", s);
+        }
+        printf("Sample rate: %d Hz\n", in.format.sample_rate);
+        printf("Slice divisor: %g\n", slice_divisor);
+        if(seg.decimate.factor > 1)
+            printf("Detection rate: %d Hz\n", in.format.sample_rate / seg.decimate.factor);
+        if(window_length != 0)
+            printf("Window: %g seconds, hop %g seconds\n", window_length, window_hop);
+        if(vad_enabled)
+            printf("Voice detection: %d sample frames\n", seg.vad.frame_length);
+        printf("\n");
+        printf("Starting to lurk...\n");
     }
-    printf("Sample rate: %d Hz\n", in.format.sample_rate);
-    printf("Slice divisor: %g\n", slice_divisor);
-    printf("\n");
-    printf("Starting to lurk...\n");
-    
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    else
+        message("Splitting %s\n", input);
     
-    while(quit == 0)
+    /* input is read by its own thread, a stalled output never stops it */
+    if(capture_start(&cap, in.stream, clip.zerocopy, in.format.sample_rate,
+                     queue_length, block_length,
+                     range_length, input_live(input), &terminate_signal) == -1)
     {
-        read_length = riff_read_wave_16(in.stream, buffer, buffer_length);
-        if(read_length < 1)
+        fprintf(stderr, "lurk: capture_start failed\n");
+        if(clip.zerocopy != NULL)
+            zerocopy_close(&zc);
+        free(silence);
+        free(clip.block);
+        spill_free(&clip.spill);
+        segmenter_free(&seg);
+        wav_close_read(&in);
+
+        return -1;
+    }
+
+    read_total = 0;
+    while(terminate_signal == 0)
+    {
+        read_length = capture_read(&cap, &buffer, buffer_length, &lost);
+        if(lost > 0)
         {
-            if(read_length == 0)
-            {
-                if(recording == 1)
-                    quit = 1; /* run loop one last time */
-                else
-                    break;
-            }
-            else
+            message("Output stalled, %.1f seconds of input replaced with silence\n",
+                    (double)lost / in.format.sample_rate);
+            if(lurk_lost(&seg, &clip, silence, buffer_length, read_total, lost) == -1)
             {
-                fprintf(stderr, "Error reading input file\n");
-
-                if(recording == 1)
-                {
-                    message("Trying to close output file nicely\n");
-                    wav_close_write(&out);
-                    rename(output_temp_path, output_path);
-                }
+                fprintf(stderr, "lurk: segmenter_push failed\n");
+                r = -1;
 
                 break;
             }
+            read_total += lost;
         }
-
-        if(terminate_signal == 1)
-            quit = 1;
-        
-        rms = root_mean_square(buffer, read_length);
-        total_length += read_length;
-        
-        if(recording == 1)
+        else if(read_length < 1)
         {
-            if((double)peak_length / in.format.sample_rate > runlength || quit == 1)
-            {
-                /* stop recording to file */
-                recording = 0;
-
-                /* remove runlength seconds of silence at end of recording */
-                cut_length -= runlength * in.format.sample_rate;
-                /* adjust file */
-                wav_truncate(&out, cut_length * out.format.block_align);
-                
-                if(wav_close_write(&out) == -1)
-                    fprintf(stderr, "lurk: failed to close output file %s\n", output_temp_path);
-                
-                if(short_filter != 0 &&
-                   (double)cut_length / in.format.sample_rate < short_filter)
-                {
-                    if(unlink(output_temp_path) == -1)
-                        fprintf(stderr, "lurk: faild to unlink %s\n", output_temp_path);
-                    
-                    message("Recording removed, short filter\n");
-                }
-                else
-                {
-                    if(rename(output_temp_path, output_path) == -1)
-                        fprintf(stderr, "lurk: faild to rename %s to %s\n", output_temp_path, output_path);
-                    
-                    message("Recording stopped, %d minutes %d seconds recorded\n",
-                            (int)(cut_length / in.format.sample_rate) / 60,
-                            /* (int)(ceil(cut_length / in.format.sample_rate)) % 60 */
-                            (int)(cut_length / in.format.sample_rate) % 60
-                            );
-                }
-                
-                free(output_path);
-                free(output_temp_path);
-                output_path = NULL;
-                output_temp_path = NULL;
-                cut_length = 0;
-                peak_length = 0;
-            }
-            else
+            /* reads are not restarted after a signal, that is not an error */
+            if(read_length == -1 && terminate_signal == 0)
             {
-                cut_length += read_length;
-                peak_length += read_length;
+                fprintf(stderr, "Error reading input file\n");
 
-                if(rms > threshold)
-                    peak_length = 0;
+                if(seg.recording == 1)
+                    message("Trying to close output file nicely\n");
             }
+
+            break;
         }
         else
         {
-            if(rms > threshold)
-            {
-                time_t t;
-                char *s, *d;
-                char expanded[PATH_MAX];
-                
-                /* start recording to file */
-                recording = 1;
-
-                /* fancy print output path (non-absolute path etc) */
-                if(time_start != 0)
-                    t = time_start + total_length / in.format.sample_rate;
-                else
-                    time(&t);
-                strftime(expanded, sizeof(expanded), output, localtime(&t));
-                message("Recording started to %s\n", expanded);
-
-                if(asprintf(&output_path, "%s%s",
-                            (output[0] == '/' ? "" : current_dir), /* make absolute if relative */
-                            expanded
-                            ) == -1)
-                {
-                    fprintf(stderr, "lurk: asprintf failed: output_path\n");
+            read_total += read_length;
 
-                    return -1;
-                }
-                if(asprintf(&output_temp_path, "%s%s",
-                            output_path,
-                            recording_append
-                            ) == -1)
-                {
-                    fprintf(stderr, "lurk: asprintf failed: output_temp_path\n");
+            if(segmenter_push(&seg, buffer, read_length) == -1)
+            {
+                fprintf(stderr, "lurk: segmenter_push failed\n");
+                r = -1;
 
-                    return -1;
-                }
-                
-                s = strdup(output_path);
-                if(s == NULL)
-                {
-                    fprintf(stderr, "lurk: strdup failed: output_path\n");
+                break;
+            }
 
-                    return -1;
-                }
-                d = dirname(s);
-                if(mkdirp(d) == -1)
-                {
-                    fprintf(stderr, "lurk: mkdirp failed: %s\n", d);
+            /* after detection so activity is marked in the right segment */
+            if(rolling_length != 0)
+                rolling_append(&clip, buffer, read_length, read_total - read_length);
+            capture_release(&cap);
+        }
 
-                    return -1;
-                }
-                free(s);
-                
-                out.riff.size = INT32_MAX; /* as big as possible, wav_close_write will fix them */
-                out.data.size = INT32_MAX;
-                out.format.audio_format = 1; /* PCM */
-                out.format.num_channels = 1; /* mono */
-                out.format.sample_rate = in.format.sample_rate;
-                out.format.byte_rate = in.format.byte_rate;
-                out.format.block_align = in.format.block_align;
-                out.format.bits_per_sample = in.format.bits_per_sample;
-
-                if(wav_open_write(output_temp_path, &out) == -1)
-                {
-                    fprintf(stderr, "lurk: failed to open temp output file %s\n", output_temp_path);
+        /* input the segmenter is done with and did not write is dropped */
+        if(clip.zerocopy != NULL &&
+           zerocopy_release(&zc, (seg.total_length - seg.preroll_used) * sizeof(int16_t)) == -1)
+        {
+            fprintf(stderr, "lurk: zerocopy_release failed\n");
+            r = -1;
 
-                    return -1;
-                }
-            }
+            break;
         }
-/*
-        progress_temp = total_length / in.format.sample_rate;
-        if(progress_temp > progress_position)
-        {
-            progress_position = progress_temp;
-            message("%s %c",
-                   (recording == 1 ? "Recording" : "Lurking"),
-                   progress[progress_position % sizeof(progress)]
-                   );
 
-            fflush(stdout);
+        /* new settings are used from the next slice, clip in progress and
+         * input are left alone */
+        if(seen_reload != reload_signal)
+        {
+            seen_reload = reload_signal;
+            if(config_reload(seen_reload, &config) == 0)
+            {
+                if(segmenter_configure(&seg, &config) == -1)
+                    message("Failed to change settings for %s\n", (input == NULL ? "stdin" : input));
+                else if(job->verbose)
+                    message("Reloaded %s, threshold %g runlength %g filter %g\n",
+                            config_path, config.threshold, config.runlength, config.short_filter);
+            }
         }
-*/        
 
         /* bloated fancy status featuring cut length, volume-meter and more! */
+        if(job->verbose)
         {
             int p, l;
             char b[21];
             
-            progress_position = total_length / in.format.sample_rate;
+            progress_position = seg.total_length / in.format.sample_rate;
             
-            l = sizeof(b) * rms;
+            l = sizeof(b) * seg.level;
             for(p = 0; p < sizeof(b) - 1; p++)
                 b[p] = (p < l ? '=' : ' ');
             b[sizeof(b) - 1] = '\0';
             
             message("%s %c [t:%.1f c:%.1f p:%.1f] [%s]",
-                   (recording == 1 ? "Recording" : "Lurking"),
+                   (seg.recording == 1 ? "Recording" : "Lurking"),
                    progress[progress_position % sizeof(progress)],
-                   (double)total_length / in.format.sample_rate,
-                   (double)cut_length / in.format.sample_rate,
-                   (double)peak_length / in.format.sample_rate,
+                   (double)seg.total_length / in.format.sample_rate,
+                   (double)seg.cut_length / in.format.sample_rate,
+                   (double)seg.peak_length / in.format.sample_rate,
                    b
                    );
             
             fflush(stdout);
         }
-        
-        if(recording == 1)
-        {
-            /* write audio to file */
-            if(riff_write_wave_16(out.stream, buffer, read_length) == -1)
-            {
-                fprintf(stderr, "lurk: riff_write_wave_16 failed\n");
+    }
 
-                return -1;
-            }
-        }
+    capture_stop(&cap);
+
+    /* end of input or signal, close clip if recording */
+    if(r == 0 && segmenter_finish(&seg) == -1)
+    {
+        fprintf(stderr, "lurk: segmenter_finish failed\n");
+        r = -1;
     }
+    if(clip.end != 0)
+        rolling_close(&clip, read_total);
+    rolling_free(&clip);
 
+    if(clip.zerocopy != NULL)
+        zerocopy_close(&zc);
     wav_close_read(&in);
-    free(buffer);
-    if(output_path != NULL)
-        free(output_path);
-    if(output_temp_path != NULL)
-        free(output_temp_path);
+    free(silence);
+    free(clip.block);
+    spill_free(&clip.spill);
+    segmenter_free(&seg);
+    clip_free_paths(&clip);
     
-    message("Stopped\n");
+    if(job->verbose)
+        message("Stopped\n");
+    else
+        message("Done with %s\n", input);
 
-    return 0;
+    return r;
+}
+
+/* batch worker, takes the next input until all are done */
+void *lurk_thread(void *arg)
+{
+    lurk_job *job;
+
+    while(terminate_signal == 0)
+    {
+        pthread_mutex_lock(&job_mutex);
+        job = (job_next < input_count ? &job_list[job_next++] : NULL);
+        pthread_mutex_unlock(&job_mutex);
+
+        if(job == NULL)
+            break;
+
+        job->result = lurk(job);
+    }
+
+    return NULL;
 }
 
 int main(int argc, char **argv)
 {
     int r;
     int option;
-    struct option getopt_options[] =
-    {
-        {"help", 0, 0, 'h'},
-        {"input", 1, 0, 'i'},
-        {"output", 1, 0, 'o'},
-        {"append", 1, 0, 'a'},
-        {"threshold", 1, 0, 't'},
-        {"runlength", 1, 0, 'r'},
-        {"filter", 1, 0, 'f'},
-        {"start", 1, 0, 's'},
-        {"divisor", 1, 0, 'd'},
-        {NULL, 0, 0, 0}
-    };
+
+    if(argc > 1 && strcmp(argv[1], "query") == 0)
+        return query(argc, argv);
 
     /* defaults */
-    input = NULL; /* stdin */
+    inputs = NULL; /* stdin */
+    input_count = 0;
     output = "clip_%F_%H:%M:%S.wav";
     /* use .wav to be nice to people who like to listen while recording */
     recording_append = ".recording.wav";
@@ -467,21 +1956,49 @@ int main(int argc, char **argv)
     runlength = 4;
     short_filter = 0; /* dont filter */
     time_start = 0; /* 0 = use system time */
+    time_start_mtime = 0;
+    time_name_format = NULL;
+    jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    raw_rate = 0; /* 0 = wav header */
+    jitter_depth = 8;
+    splice_input = 0;
+    clip_stats_enabled = 0;
+    vad_enabled = 0;
     slice_divisor = 60;
+    window_length = 0; /* 0 = rms of each slice */
+    window_hop = 0; /* 0 = every sample */
+    detect_rate = 0; /* 0 = full sample rate */
+    compact_length = 0; /* dont compact */
+    compact_gap = 0.5;
+    config_path = NULL;
+    spill_length = 10;
+    range_begin = 0;
+    range_end = 0; /* to end of input */
+    rolling_length = 0; /* clips */
+    catalog_path = NULL;
+    min_free = 0; /* dont check */
+    full_policy = FULL_PAUSE;
 
     /* shameless plug */
     printf("lurker 0.4, (C)2004 Mattias Wadman <mattias.wadman@softdays.se>\n");
 
     while(1)
     {
-        option = getopt_long(argc, argv, "hi:o:a:t:r:f:s:d:", getopt_options, NULL);
+        option = getopt_long(argc, argv, "hi:o:a:t:r:f:s:d:w:p:D:c:g:j:n:R:J:ZSVC:B:m:F:b:e:l:x:", options, NULL);
 
         if(option == -1)
             break;
         else if(option == 'h')
         {
-            printf("Usage: %s [OPTION]...\n"
-                   "    -i, --input PATH       Input file (stdin)\n"
+            printf("Usage: %s [OPTION]... [INPUT]...\n"
+                   "    -i, --input PATH       Input wav or flac file, or directory, can be repeated (stdin)\n"
+                   "                           Eg: tcp://host:port (connect), tcp://:port (listen)\n"
+                   "                           Eg: udp://:port (raw packets, see README)\n"
+                   "    -b, --begin NUMBER     Start at NUMBER seconds into input\n"
+                   "    -e, --end NUMBER       Stop at NUMBER seconds into input, 0 for end of input\n"
+                   "    -R, --raw HZ           Input is headerless 16 bit mono PCM at HZ\n"
+                   "    -J, --jitter NUMBER    UDP packets to buffer for reordering (%d)\n"
+                   "    -Z, --splice           Move audio from stdin pipe to file without copying\n"
                    "    -o, --output PATH      Output path, strftime formated (%s)\n"
                    "    -a, --append STRING    Append to filename while recording (%s)\n"
                    "    -t, --threshold NUMBER Sound level threshold to trigger (%g)\n"
@@ -490,55 +2007,58 @@ int main(int argc, char **argv)
                    "    -s, --start DATETIME   Use a given start time and offset with audio time\n"
                    "                           Eg: \"2000-01-02 03:04:05\"\n"
                    "                           Eg: now (use system clock as start)\n"
+                   "                           Eg: mtime (input modification time minus length)\n"
+                   "    -n, --name-time FORMAT Parse start time from input file name, strptime formated\n"
+                   "                           Eg: \"rec_%%Y%%m%%d_%%H%%M%%S.wav\"\n"
                    "    -d, --divisor NUMBER   Slice sample rate into NUMBER parts internally (%g)\n"
+                   "    -w, --window NUMBER    Sliding RMS window in seconds, 0 for per slice (%g)\n"
+                   "    -p, --hop NUMBER       Seconds between sliding window checks, 0 for every sample (%g)\n"
+                   "    -D, --detect-rate HZ   Detect on audio decimated to about HZ, 0 for full rate (%d)\n"
+                   "    -c, --compact NUMBER   Shorten silences longer then NUMBER seconds in clips (%g)\n"
+                   "    -g, --gap NUMBER       Seconds of silence left when compacting (%g)\n"
+                   "    -S, --stats            Put peak, RMS, clipping and loudness in clip LIST chunk\n"
+                   "    -V, --vad              Trigger on speech only, -t is the lowest level used\n"
+                   "    -l, --rolling NUMBER   Record everything in files of NUMBER seconds, activity\n"
+                   "                           is marked with cue points instead of clips\n"
+                   "    -x, --catalog FILE     Add finished clips to FILE, see %s query\n"
+                   "    -j, --jobs NUMBER      Split this many inputs at the same time (%d)\n"
+                   "    -C, --config FILE      Read long options from FILE, SIGHUP rereads it\n"
+                   "    -B, --spill NUMBER     Seconds of output to hold in memory if writing stalls (%g)\n"
+                   "    -m, --min-free NUMBER  MB to keep free on output file system, 0 to not check (%g)\n"
+                   "    -F, --full POLICY      When low on space: pause, delete (oldest clip) or\n"
+                   "                           degrade (new clips are 8 bit) (pause)\n"
                    "",
-                   argv[0], output, recording_append, threshold, runlength,
-                   short_filter, slice_divisor
+                   argv[0], jitter_depth, output, recording_append, threshold, runlength,
+                   short_filter, slice_divisor, window_length, window_hop,
+                   detect_rate, compact_length, compact_gap, argv[0], jobs,
+                   spill_length, min_free
                    );
 
             return EXIT_SUCCESS;
         }
-        else if(option == 'i')
-            input = optarg;
-        else if(option == 'o')
-            output = optarg;
-        else if(option == 'a')
-            recording_append = optarg;
-        else if(option == 't')
-            threshold = atof(optarg);
-        else if(option == 'r')
-            runlength = atof(optarg);
-        else if(option == 'f')
-            short_filter = atof(optarg);
-        else if(option == 's')
-        {
-            struct tm t;
-            char *s;
-
-            if(strcmp(optarg, "now") == 0)
-                time_start = time(NULL);
-            else
-            {
-                s = strptime(optarg, "%Y-%m-%d %H:%M:%S", &t);
-                if(s == NULL || *s != '\0')
-                {
-                    fprintf(stderr, "Invalid time format\n");
-
-                    return EXIT_FAILURE;
-                }
-                
-                time_start = mktime(&t);
-            }
-        }
-        else if(option == 'd')
-            slice_divisor = atof(optarg);
-        else
+        else if(option == 'C')
         {
-            fprintf(stderr, "Error in argument: %c\n", option);
+            config_path = optarg;
+            if(config_load(config_path, 0) == -1)
+                return EXIT_FAILURE;
+        }
+        else if(set_option(option, optarg) == -1)
+            return EXIT_FAILURE;
+    }
 
+    /* inputs can also be given without -i */
+    for(; optind < argc; optind++)
+        if(add_input(argv[optind]) == -1)
             return EXIT_FAILURE;
-        }
+
+    if(range_end != 0 && range_end <= range_begin)
+    {
+        fprintf(stderr, "End of range must be after beginning\n");
+
+        return EXIT_FAILURE;
     }
+    if(rolling_check_config() == -1)
+        return EXIT_FAILURE;
    
     /* string used to clear current line */
     clear_line = generate_clear_line_string();
@@ -572,7 +2092,98 @@ int main(int argc, char **argv)
         current_dir = t;
     }
 
-    r = lurk();
+    if(catalog_path != NULL && catalog_open(catalog_path, &clip_catalog) == -1)
+        return EXIT_FAILURE;
+
+    terminate_signal = 0;
+    {
+        struct sigaction sa;
+
+        /* no SA_RESTART, a blocking read on a quiet network input should
+         * return so we can stop */
+        memset(&sa, 0, sizeof(sa));
+        sa.sa_handler = signal_handler;
+        sigaction(SIGINT, &sa, NULL);
+        sigaction(SIGTERM, &sa, NULL);
+
+        /* reload config between slices, reads should just continue */
+        if(config_path != NULL)
+        {
+            sa.sa_handler = reload_handler;
+            sa.sa_flags = SA_RESTART;
+            sigaction(SIGHUP, &sa, NULL);
+        }
+    }
+
+    if(input_count < 2)
+    {
+        lurk_job job;
+
+        job.input = (input_count == 0 ? NULL : inputs[0]);
+        job.verbose = 1;
+        r = lurk(&job);
+    }
+    else
+    {
+        pthread_t *threads;
+        int i;
+
+        if(jobs < 1)
+            jobs = 1;
+        if(jobs > input_count)
+            jobs = input_count;
+
+        job_list = malloc(input_count * sizeof(lurk_job));
+        threads = malloc(jobs * sizeof(pthread_t));
+        if(job_list == NULL || threads == NULL)
+        {
+            fprintf(stderr, "malloc jobs failed\n");
+
+            return EXIT_FAILURE;
+        }
+
+        printf("Output: %s\n", output);
+        printf("Threshold: %g\n", threshold);
+        printf("Runlength: %g seconds\n", runlength);
+        printf("Splitting %d inputs, %d at a time\n", input_count, jobs);
+
+        for(i = 0; i < input_count; i++)
+        {
+            job_list[i].input = inputs[i];
+            job_list[i].verbose = 0;
+            job_list[i].result = -1; /* not run if interrupted */
+        }
+        job_next = 0;
+
+        for(i = 0; i < jobs; i++)
+            if(pthread_create(&threads[i], NULL, lurk_thread, NULL) != 0)
+            {
+                fprintf(stderr, "pthread_create failed\n");
+
+                break;
+            }
+        /* run what was started, if none could be started do it here */
+        if(i == 0)
+            lurk_thread(NULL);
+        jobs = i;
+        for(i = 0; i < jobs; i++)
+            pthread_join(threads[i], NULL);
+
+        r = 0;
+        for(i = 0; i < input_count; i++)
+            if(job_list[i].result == -1)
+            {
+                fprintf(stderr, "Failed to split %s\n", job_list[i].input);
+                r = -1;
+            }
+
+        free(threads);
+        free(job_list);
+    }
+
+    if(catalog_path != NULL)
+        catalog_close(&clip_catalog);
+    free(inputs);
     free(current_dir);
     free(clear_line);
 
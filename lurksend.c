@@ -0,0 +1,184 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/* test sender for lurker network input, sends a wav file over udp as
+ * sequenced raw packets, optionally losing and reordering some, or as is
+ * over tcp */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <endian.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+#include "riff.h"
+#include "wav.h"
+#include "net.h"
+
+
+int main(int argc, char **argv)
+{
+    struct addrinfo hints, *a;
+    wav_file in;
+    int option, fd, tcp, samples, i, n, e;
+    double loss, reorder, speed;
+    uint32_t sequence;
+    uint8_t packet[NET_PACKET_MAX], held[NET_PACKET_MAX];
+    int held_bytes;
+    int16_t *buffer;
+    struct timespec delay;
+
+    tcp = 0;
+    samples = 160;
+    loss = 0;
+    reorder = 0;
+    speed = 1;
+
+    while((option = getopt(argc, argv, "tp:l:o:x:")) != -1)
+    {
+        if(option == 't')
+            tcp = 1;
+        else if(option == 'p')
+            samples = atoi(optarg);
+        else if(option == 'l')
+            loss = atof(optarg) / 100;
+        else if(option == 'o')
+            reorder = atof(optarg) / 100;
+        else if(option == 'x')
+            speed = atof(optarg);
+        else
+            break;
+    }
+
+    if(argc - optind != 3 || samples < 1 ||
+       samples * sizeof(int16_t) > NET_PACKET_MAX - NET_PACKET_HEADER || speed <= 0)
+    {
+        fprintf(stderr,
+                "Usage: %s [-t] [-p SAMPLES] [-l PERCENT] [-o PERCENT] [-x SPEED] HOST PORT FILE\n"
+                "    -t          Send wav file as is over tcp instead of udp packets\n"
+                "    -p SAMPLES  Samples per udp packet (160)\n"
+                "    -l PERCENT  Lose this many percent of the packets\n"
+                "    -o PERCENT  Swap this many percent of the packets with the next one\n"
+                "    -x SPEED    Send this many times faster then realtime (1)\n",
+                argv[0]);
+
+        return EXIT_FAILURE;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = (tcp ? SOCK_STREAM : SOCK_DGRAM);
+    e = getaddrinfo(argv[optind], argv[optind + 1], &hints, &a);
+    if(e != 0)
+    {
+        fprintf(stderr, "getaddrinfo: %s\n", gai_strerror(e));
+
+        return EXIT_FAILURE;
+    }
+    fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+    if(fd == -1 || connect(fd, a->ai_addr, a->ai_addrlen) == -1)
+    {
+        fprintf(stderr, "Failed to connect\n");
+
+        return EXIT_FAILURE;
+    }
+    freeaddrinfo(a);
+
+    if(tcp)
+    {
+        FILE *f = fopen(argv[optind + 2], "r");
+
+        if(f == NULL)
+        {
+            fprintf(stderr, "Failed to open %s\n", argv[optind + 2]);
+
+            return EXIT_FAILURE;
+        }
+        while((n = fread(packet, 1, sizeof(packet), f)) > 0)
+            if(write(fd, packet, n) != n)
+            {
+                fprintf(stderr, "write failed\n");
+
+                return EXIT_FAILURE;
+            }
+        fclose(f);
+        close(fd);
+
+        return EXIT_SUCCESS;
+    }
+
+    if(wav_open_read(argv[optind + 2], &in) == -1)
+        return EXIT_FAILURE;
+
+    buffer = (int16_t *)(packet + NET_PACKET_HEADER);
+    delay.tv_sec = (double)samples / in.format.sample_rate / speed;
+    delay.tv_nsec = 1000000000.0 * ((double)samples / in.format.sample_rate / speed - delay.tv_sec);
+    sequence = 0;
+    held_bytes = 0;
+    srand(time(NULL));
+
+    while((n = riff_read_wave_16(in.stream, buffer, samples)) > 0)
+    {
+        packet[0] = sequence >> 24;
+        packet[1] = sequence >> 16;
+        packet[2] = sequence >> 8;
+        packet[3] = sequence;
+        sequence++;
+        for(i = 0; i < n; i++)
+            buffer[i] = htole16(buffer[i]);
+        n = NET_PACKET_HEADER + n * sizeof(int16_t);
+
+        if((double)rand() / RAND_MAX < loss)
+            ;
+        else if(held_bytes == 0 && (double)rand() / RAND_MAX < reorder)
+        {
+            /* send after next packet */
+            memcpy(held, packet, n);
+            held_bytes = n;
+        }
+        else
+        {
+            send(fd, packet, n, 0);
+            if(held_bytes > 0)
+            {
+                send(fd, held, held_bytes, 0);
+                held_bytes = 0;
+            }
+        }
+
+        nanosleep(&delay, NULL);
+    }
+    if(held_bytes > 0)
+        send(fd, held, held_bytes, 0);
+
+    printf("Sent %u packets\n", sequence);
+
+    wav_close_read(&in);
+    close(fd);
+
+    return EXIT_SUCCESS;
+}
+
@@ -0,0 +1,466 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+#include "wav.h"
+#include "net.h"
+
+
+/* reorder buffer for udp packets, slot is sequence % depth */
+struct net_jitter
+{
+    int fd;
+    int depth;
+    int sample_rate;
+    int packet_bytes; /* audio bytes per packet, from first packet */
+    int started;
+    uint32_t expected; /* next sequence number to read */
+    uint8_t **slots;
+    int *filled;
+    uint8_t *overflow; /* packet too far ahead to fit in slots yet */
+    uint32_t overflow_sequence;
+    int overflow_bytes;
+    uint8_t *current; /* packet being read, points into slots or silence */
+    int current_bytes;
+    int current_position;
+    uint8_t *silence;
+    uint8_t packet[NET_PACKET_MAX];
+    uint64_t lost;
+    uint64_t late;
+    uint32_t gap; /* packets left of a reported outage */
+};
+
+typedef struct net_jitter net_jitter;
+
+
+int net_is_uri(char *uri)
+{
+    return (strncmp(uri, "tcp://", 6) == 0 || strncmp(uri, "udp://", 6) == 0);
+}
+
+/* split "host:port", "[host]:port" or ":port" and resolve it */
+static struct addrinfo *net_resolve(char *address, int type)
+{
+    struct addrinfo hints, *r;
+    char *s, *host, *port;
+    int e;
+
+    s = strdup(address);
+    if(s == NULL)
+        return NULL;
+
+    port = strrchr(s, ':');
+    if(port == NULL)
+    {
+        fprintf(stderr, "net_resolve: no port in %s\n", address);
+        free(s);
+
+        return NULL;
+    }
+    *port++ = '\0';
+    host = s;
+    if(host[0] == '[' && host[strlen(host) - 1] == ']')
+    {
+        host[strlen(host) - 1] = '\0';
+        host++;
+    }
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = type;
+    hints.ai_flags = (host[0] == '\0' ? AI_PASSIVE : 0);
+
+    e = getaddrinfo((host[0] == '\0' ? NULL : host), port, &hints, &r);
+    free(s);
+    if(e != 0)
+    {
+        fprintf(stderr, "net_resolve: %s: %s\n", address, gai_strerror(e));
+
+        return NULL;
+    }
+
+    return r;
+}
+
+/* connect if a host is given, otherwise listen and take the first client */
+static int net_tcp(char *address)
+{
+    struct addrinfo *a, *i;
+    int fd, client, on = 1;
+
+    a = net_resolve(address, SOCK_STREAM);
+    if(a == NULL)
+        return -1;
+
+    fd = -1;
+    for(i = a; i != NULL; i = i->ai_next)
+    {
+        fd = socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+        if(fd == -1)
+            continue;
+
+        if(address[0] == ':')
+        {
+            setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+            if(bind(fd, i->ai_addr, i->ai_addrlen) == 0 && listen(fd, 1) == 0)
+                break;
+        }
+        else if(connect(fd, i->ai_addr, i->ai_addrlen) == 0)
+            break;
+
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(a);
+
+    if(fd == -1)
+    {
+        fprintf(stderr, "net_tcp: failed to open %s\n", address);
+
+        return -1;
+    }
+
+    if(address[0] != ':')
+        return fd;
+
+    fprintf(stderr, "net_tcp: waiting for connection on %s\n", address);
+    client = accept(fd, NULL, NULL);
+    close(fd);
+    if(client == -1)
+        fprintf(stderr, "net_tcp: accept failed\n");
+
+    return client;
+}
+
+static int net_udp(char *address)
+{
+    struct addrinfo *a, *i;
+    int fd;
+
+    a = net_resolve(address, SOCK_DGRAM);
+    if(a == NULL)
+        return -1;
+
+    fd = -1;
+    for(i = a; i != NULL; i = i->ai_next)
+    {
+        fd = socket(i->ai_family, i->ai_socktype, i->ai_protocol);
+        if(fd == -1)
+            continue;
+        if(bind(fd, i->ai_addr, i->ai_addrlen) == 0)
+            break;
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(a);
+
+    if(fd == -1)
+        fprintf(stderr, "net_udp: failed to bind %s\n", address);
+
+    return fd;
+}
+
+/* place a received packet, returns 1 if it has to wait in overflow */
+static int net_jitter_put(net_jitter *j, uint32_t sequence, uint8_t *data, int bytes)
+{
+    int32_t ahead = sequence - j->expected;
+    int slot;
+
+    if(ahead < 0)
+    {
+        /* already played out as silence or a duplicate */
+        j->late++;
+
+        return 0;
+    }
+
+    if(ahead >= j->depth)
+        return 1;
+
+    slot = sequence % j->depth;
+    if(bytes > j->packet_bytes)
+        bytes = j->packet_bytes;
+    memcpy(j->slots[slot], data, bytes);
+    /* short packet, pad so sample clock stays the same */
+    memset(j->slots[slot] + bytes, 0, j->packet_bytes - bytes);
+    j->filled[slot] = 1;
+
+    return 0;
+}
+
+/* receive until expected packet is there, or something far enough ahead
+ * arrived that expected is given up on. returns 1 when there is a packet to
+ * read, 0 on end of stream */
+static int net_jitter_next(net_jitter *j)
+{
+    int slot, n;
+    uint32_t sequence;
+
+    while(1)
+    {
+        slot = j->expected % j->depth;
+        if(j->started && j->filled[slot])
+        {
+            j->filled[slot] = 0;
+            j->current = j->slots[slot];
+            j->expected++;
+
+            break;
+        }
+
+        if(j->overflow_bytes > 0)
+        {
+            /* expected is lost, play silence in its place */
+            j->lost++;
+            if(j->gap > 0)
+                j->gap--;
+            else if(j->lost == 1 || j->lost % 100 == 0)
+                fprintf(stderr, "net: sequence %u lost, inserting silence (%llu lost)\n",
+                        j->expected, (unsigned long long)j->lost);
+            j->current = j->silence;
+            j->expected++;
+
+            if(net_jitter_put(j, j->overflow_sequence, j->overflow, j->overflow_bytes) == 0)
+                j->overflow_bytes = 0;
+
+            break;
+        }
+
+        n = recv(j->fd, j->packet, sizeof(j->packet), 0);
+        if(n == -1 && errno == EINTR)
+            return 0; /* signal, treat as end of stream */
+        if(n == -1)
+        {
+            fprintf(stderr, "net: recv failed\n");
+
+            return -1;
+        }
+        if(n < NET_PACKET_HEADER + 2)
+            continue;
+
+        sequence = ((uint32_t)j->packet[0] << 24 | (uint32_t)j->packet[1] << 16 |
+                    (uint32_t)j->packet[2] << 8 | (uint32_t)j->packet[3]);
+        n -= NET_PACKET_HEADER;
+
+        if(!j->started)
+        {
+            int i;
+
+            j->packet_bytes = n & ~1;
+            for(i = 0; i < j->depth; i++)
+            {
+                j->slots[i] = malloc(j->packet_bytes);
+                if(j->slots[i] == NULL)
+                    return -1;
+            }
+            j->silence = calloc(1, j->packet_bytes);
+            j->overflow = malloc(j->packet_bytes);
+            if(j->silence == NULL || j->overflow == NULL)
+                return -1;
+            j->expected = sequence;
+            j->started = 1;
+        }
+        else if((int32_t)(sequence - j->expected) > j->depth * 64 &&
+                (int32_t)(sequence - j->expected) <=
+                (int64_t)NET_GAP_MAX_SECONDS * j->sample_rate / (j->packet_bytes / 2))
+        {
+            /* outage, the missing packets are played as silence below so
+             * the sample clock keeps up with the sender */
+            j->gap = sequence - j->expected;
+            fprintf(stderr, "net: sequence jumped from %u to %u, inserting %g seconds of silence\n",
+                    j->expected, sequence,
+                    (double)j->gap * (j->packet_bytes / 2) / j->sample_rate);
+        }
+        else if((int32_t)(sequence - j->expected) > j->depth * 64 ||
+                (int32_t)(sequence - j->expected) < -j->depth * 64)
+        {
+            /* sender probably restarted, or gone too long to fill */
+            fprintf(stderr, "net: sequence jumped from %u to %u, resyncing\n",
+                    j->expected, sequence);
+            memset(j->filled, 0, j->depth * sizeof(int));
+            j->overflow_bytes = 0;
+            j->gap = 0;
+            j->expected = sequence;
+        }
+
+        if(net_jitter_put(j, sequence, j->packet + NET_PACKET_HEADER, n) == 1)
+        {
+            if(n > j->packet_bytes)
+                n = j->packet_bytes;
+            memcpy(j->overflow, j->packet + NET_PACKET_HEADER, n);
+            memset(j->overflow + n, 0, j->packet_bytes - n);
+            j->overflow_sequence = sequence;
+            j->overflow_bytes = j->packet_bytes;
+        }
+    }
+
+    j->current_bytes = j->packet_bytes;
+    j->current_position = 0;
+
+    return 1;
+}
+
+static ssize_t net_jitter_read(void *cookie, char *buffer, size_t size)
+{
+    net_jitter *j = cookie;
+    size_t n;
+    int r;
+
+    if(j->current_position == j->current_bytes)
+    {
+        r = net_jitter_next(j);
+        if(r != 1)
+            return r;
+    }
+
+    n = j->current_bytes - j->current_position;
+    if(n > size)
+        n = size;
+    memcpy(buffer, j->current + j->current_position, n);
+    j->current_position += n;
+
+    return n;
+}
+
+static int net_jitter_close(void *cookie)
+{
+    net_jitter *j = cookie;
+    int i;
+
+    if(j->lost > 0 || j->late > 0)
+        fprintf(stderr, "net: %llu packets lost, %llu late\n",
+                (unsigned long long)j->lost, (unsigned long long)j->late);
+
+    close(j->fd);
+    if(j->started)
+        for(i = 0; i < j->depth; i++)
+            free(j->slots[i]);
+    free(j->slots);
+    free(j->filled);
+    free(j->silence);
+    free(j->overflow);
+    free(j);
+
+    return 0;
+}
+
+static FILE *net_jitter_open(int fd, int depth, int sample_rate)
+{
+    net_jitter *j;
+    cookie_io_functions_t io = {net_jitter_read, NULL, NULL, net_jitter_close};
+    FILE *stream;
+
+    if(depth < 1)
+        depth = 1;
+
+    j = calloc(1, sizeof(net_jitter));
+    if(j == NULL)
+        return NULL;
+    j->fd = fd;
+    j->depth = depth;
+    j->sample_rate = sample_rate;
+    j->slots = calloc(depth, sizeof(uint8_t *));
+    j->filled = calloc(depth, sizeof(int));
+    if(j->slots == NULL || j->filled == NULL)
+    {
+        free(j->slots);
+        free(j->filled);
+        free(j);
+
+        return NULL;
+    }
+
+    stream = fopencookie(j, "r", io);
+    if(stream == NULL)
+    {
+        free(j->slots);
+        free(j->filled);
+        free(j);
+    }
+
+    return stream;
+}
+
+/* tcp://host:port connects, tcp://:port listens. stream is wav unless
+ * raw_rate is set. udp://:port receives raw packets, see net.h */
+int net_open_read(char *uri, int raw_rate, int jitter_depth, wav_file *w)
+{
+    FILE *stream;
+    int fd;
+
+    if(strncmp(uri, "tcp://", 6) == 0)
+    {
+        fd = net_tcp(uri + 6);
+        if(fd == -1)
+            return -1;
+
+        stream = fdopen(fd, "r");
+        if(stream == NULL)
+        {
+            fprintf(stderr, "net_open_read: fdopen failed\n");
+            close(fd);
+
+            return -1;
+        }
+
+        if(raw_rate != 0)
+            return wav_open_raw(stream, raw_rate, w);
+        else
+            return wav_open_stream(stream, w);
+    }
+    else if(strncmp(uri, "udp://", 6) == 0)
+    {
+        if(raw_rate == 0)
+        {
+            fprintf(stderr, "net_open_read: udp input needs a raw sample rate\n");
+
+            return -1;
+        }
+
+        fd = net_udp(uri + 6);
+        if(fd == -1)
+            return -1;
+
+        stream = net_jitter_open(fd, jitter_depth, raw_rate);
+        if(stream == NULL)
+        {
+            fprintf(stderr, "net_open_read: failed to set up jitter buffer\n");
+            close(fd);
+
+            return -1;
+        }
+
+        return wav_open_raw(stream, raw_rate, w);
+    }
+
+    fprintf(stderr, "net_open_read: unknown uri %s\n", uri);
+
+    return -1;
+}
+
@@ -0,0 +1,19 @@
+#ifndef __NET_H__
+#define __NET_H__
+
+#include <stdint.h>
+
+#include "wav.h"
+
+/* udp packets are a 32 bit big endian sequence number followed by 16 bit
+ * little endian mono samples, same number of samples in every packet */
+#define NET_PACKET_HEADER 4
+#define NET_PACKET_MAX 65536
+#define NET_GAP_MAX_SECONDS 3600 /* longer outages are not filled with silence */
+
+
+int net_is_uri(char *uri);
+int net_open_read(char *uri, int raw_rate, int jitter_depth, wav_file *w);
+
+#endif
+
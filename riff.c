@@ -19,7 +19,9 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <endian.h>
 #include <byteswap.h>
 
@@ -161,3 +163,44 @@ int riff_write_wave_16(FILE *stream, int16_t *buffer, int length)
     return 0;
 }
 
+
+int riff_buffer_add(riff_buffer *b, void *data, int length)
+{
+    uint8_t *t;
+
+    t = realloc(b->data, b->size + length);
+    if(t == NULL)
+        return -1;
+    b->data = t;
+    memcpy(b->data + b->size, data, length);
+    b->size += length;
+
+    return 0;
+}
+
+/* add chunk with id and data, padded to even size */
+int riff_buffer_add_chunk(riff_buffer *b, char *id, void *data, int length)
+{
+    int32_t size = length;
+    uint8_t pad = 0;
+
+#if __BYTE_ORDER != __LITTLE_ENDIAN
+    size = bswap_32(size);
+#endif
+
+    if(riff_buffer_add(b, id, 4) == -1 ||
+       riff_buffer_add(b, &size, sizeof(size)) == -1 ||
+       riff_buffer_add(b, data, length) == -1 ||
+       (length % 2 == 1 && riff_buffer_add(b, &pad, 1) == -1))
+        return -1;
+
+    return 0;
+}
+
+void riff_buffer_free(riff_buffer *b)
+{
+    free(b->data);
+    b->data = NULL;
+    b->size = 0;
+}
+
@@ -35,6 +35,15 @@ struct riff_sub_chunk_wave_data
 
 typedef struct riff_sub_chunk_wave_data riff_sub_chunk_wave_data;
 
+/* growing buffer of raw chunks, for things written after the audio data */
+struct riff_buffer
+{
+    uint8_t *data;
+    int size;
+};
+
+typedef struct riff_buffer riff_buffer;
+
 
 int riff_read_chunk(FILE *stream, riff_chunk *r);
 int riff_read_sub_chunk_wave_format(FILE *stream, riff_sub_chunk_wave_format *r);
@@ -44,6 +53,9 @@ int riff_write_chunk(FILE *stream, riff_chunk *r);
 int riff_write_sub_chunk_wave_format(FILE *stream, riff_sub_chunk_wave_format *r);
 int riff_write_sub_chunk_wave_data(FILE *stream, riff_sub_chunk_wave_data *r);
 int riff_write_wave_16(FILE *stream, int16_t *buffer, int length);
+int riff_buffer_add(riff_buffer *b, void *data, int length);
+int riff_buffer_add_chunk(riff_buffer *b, char *id, void *data, int length);
+void riff_buffer_free(riff_buffer *b);
 
 #endif
 
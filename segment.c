@@ -0,0 +1,489 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "energy.h"
+#include "decimate.h"
+#include "stats.h"
+#include "vad.h"
+#include "segment.h"
+
+
+/* discrete root mean square algorithm */
+/* http://en.wikipedia.org/wiki/Root_mean_square */
+static double root_mean_square(int16_t *buffer, int length)
+{
+    int i;
+    double sum = 0.0;
+
+    for(i = 0; i < length; i++)
+        sum += (buffer[i] * buffer[i]) / length;
+
+    return sqrt(sum) / INT16_MAX;
+}
+
+/* settings that do not work together */
+int segmenter_check_config(segment_config *config)
+{
+    if(config->compact_length != 0 &&
+       (config->compact_gap >= config->compact_length ||
+        config->compact_length >= config->runlength))
+    {
+        fprintf(stderr, "segmenter_check_config: compact length must be between gap and runlength\n");
+
+        return -1;
+    }
+
+    return 0;
+}
+
+int segmenter_init(segmenter *s, segment_config *config, segment_callbacks *callbacks, void *user)
+{
+    int detect_rate;
+
+    s->config = *config;
+    s->callbacks = *callbacks;
+    s->user = user;
+
+    if(segmenter_check_config(config) == -1)
+        return -1;
+
+    s->slice_length = config->sample_rate / config->slice_divisor;
+    if(s->slice_length < 1)
+        s->slice_length = 1;
+    s->slice = malloc(s->slice_length * sizeof(int16_t));
+    if(s->slice == NULL)
+    {
+        fprintf(stderr, "segmenter_init: malloc slice failed\n");
+
+        return -1;
+    }
+    s->slice_used = 0;
+
+    /* detection can run on every n:th sample, output is still full rate */
+    if(decimator_init(&s->decimate,
+                      (config->detect_rate > 0 && config->detect_rate < config->sample_rate ?
+                       config->sample_rate / config->detect_rate : 1),
+                      s->slice_length
+                      ) == -1)
+    {
+        fprintf(stderr, "segmenter_init: decimator_init failed\n");
+        free(s->slice);
+
+        return -1;
+    }
+    detect_rate = config->sample_rate / s->decimate.factor;
+    if(config->window_length != 0 &&
+       energy_window_init(&s->window,
+                          config->window_length * detect_rate,
+                          config->window_hop * detect_rate
+                          ) == -1)
+    {
+        fprintf(stderr, "segmenter_init: energy_window_init failed\n");
+        decimator_free(&s->decimate);
+        free(s->slice);
+
+        return -1;
+    }
+    /* keep enough audio to start a clip where speech started */
+    s->preroll = NULL;
+    s->preroll_length = 0;
+    if(config->vad)
+    {
+        if(vad_init(&s->vad, detect_rate) == -1)
+        {
+            fprintf(stderr, "segmenter_init: vad_init failed\n");
+            if(config->window_length != 0)
+                energy_window_free(&s->window);
+            decimator_free(&s->decimate);
+            free(s->slice);
+
+            return -1;
+        }
+
+        s->preroll_length = (s->vad.onset + 1) * s->vad.frame_length * s->decimate.factor;
+        s->preroll = malloc(s->preroll_length * sizeof(int16_t));
+        if(s->preroll == NULL)
+        {
+            fprintf(stderr, "segmenter_init: malloc preroll failed\n");
+            vad_free(&s->vad);
+            if(config->window_length != 0)
+                energy_window_free(&s->window);
+            decimator_free(&s->decimate);
+            free(s->slice);
+
+            return -1;
+        }
+    }
+    s->preroll_position = 0;
+    s->preroll_used = 0;
+    if(config->stats)
+        stats_init(&s->stats, config->sample_rate);
+
+    s->level = 0;
+    s->recording = 0;
+    s->total_length = 0;
+    s->cut_length = 0;
+    s->peak_length = 0;
+    s->clip_start = 0;
+    s->written_length = 0;
+    s->write_offset = 0;
+    s->removed_start = 0;
+    s->removed_length = 0;
+    s->removed_total = 0;
+    s->compacting = 0;
+    s->gap_length = 0;
+
+    return 0;
+}
+
+/* change settings while running, used from the next slice on. a clip in
+ * progress keeps going, only settings that dont size buffers can change */
+int segmenter_configure(segmenter *s, segment_config *config)
+{
+    if(config->sample_rate != s->config.sample_rate ||
+       config->slice_divisor != s->config.slice_divisor ||
+       config->window_length != s->config.window_length ||
+       config->window_hop != s->config.window_hop ||
+       config->detect_rate != s->config.detect_rate ||
+       config->stats != s->config.stats ||
+       config->vad != s->config.vad)
+    {
+        fprintf(stderr, "segmenter_configure: only threshold, runlength, short filter and compact settings can change\n");
+
+        return -1;
+    }
+
+    if(segmenter_check_config(config) == -1)
+        return -1;
+
+    s->config = *config;
+
+    return 0;
+}
+
+void segmenter_free(segmenter *s)
+{
+    free(s->slice);
+    s->slice = NULL;
+    decimator_free(&s->decimate);
+    if(s->config.window_length != 0)
+        energy_window_free(&s->window);
+    if(s->config.vad)
+        vad_free(&s->vad);
+    free(s->preroll);
+    s->preroll = NULL;
+    if(s->config.stats)
+        stats_free(&s->stats);
+}
+
+/* end current clip, trailing is number of samples of silence to cut */
+static int segmenter_stop(segmenter *s, uint64_t trailing)
+{
+    uint64_t length;
+    int keep;
+    int r;
+
+    s->recording = 0;
+
+    if(trailing > s->cut_length)
+        trailing = s->cut_length;
+    s->cut_length -= trailing;
+
+    /* adjust file, if compacting only the gap is left of the silence */
+    if(s->compacting == 1)
+        length = s->written_length - s->gap_length;
+    else
+        length = s->cut_length - s->removed_total;
+    if(s->callbacks.truncate(s->user, length) == -1)
+        return -1;
+
+    if(s->config.stats)
+    {
+        /* stats are of what is left in the file */
+        stats_cut(&s->stats, s->written_length - length);
+        stats_keep(&s->stats, 0);
+    }
+
+    /* silence being removed at the end would have been cut anyway */
+    if(s->compacting == 1)
+        s->removed_total -= s->removed_length;
+
+    keep = !(s->config.short_filter != 0 &&
+             (double)s->cut_length / s->config.sample_rate < s->config.short_filter);
+
+    r = s->callbacks.stop(s->user, s->clip_start, s->cut_length, keep);
+
+    s->cut_length = 0;
+    s->peak_length = 0;
+    s->written_length = 0;
+    s->removed_total = 0;
+    s->compacting = 0;
+
+    return r;
+}
+
+static int segmenter_write(segmenter *s, int16_t *buffer, int length)
+{
+    if(s->compacting == 1 && s->peak_length != 0)
+    {
+        /* still in a long silence, drop it */
+        s->removed_length += length;
+        s->removed_total += length;
+        s->write_offset += length;
+
+        return 0;
+    }
+
+    if(s->compacting == 1)
+    {
+        /* sound again, tell where and how much silence was removed */
+        s->compacting = 0;
+        if(s->callbacks.compact != NULL &&
+           s->callbacks.compact(s->user,
+                                s->written_length,
+                                s->removed_start,
+                                s->removed_length
+                                ) == -1)
+            return -1;
+    }
+
+    if(s->callbacks.write(s->user, buffer, length) == -1)
+        return -1;
+    s->written_length += length;
+    s->write_offset += length;
+
+    if(s->config.stats)
+    {
+        if(stats_hold(&s->stats, buffer, length) == -1)
+            return -1;
+        /* at most the silence after the last sound and one slice more is
+         * ever cut, older audio stays in the clip */
+        if(s->peak_length == 0)
+            stats_keep(&s->stats, s->slice_length);
+    }
+
+    if(s->config.compact_length != 0 &&
+       (double)s->peak_length / s->config.sample_rate > s->config.compact_length)
+    {
+        /* keep gap seconds of the silence and throw away the rest */
+        s->compacting = 1;
+        s->gap_length = s->config.compact_gap * s->config.sample_rate;
+        s->removed_length = s->peak_length - s->gap_length;
+        s->removed_total += s->removed_length;
+        s->written_length -= s->removed_length;
+        s->removed_start = s->total_length - s->clip_start - s->removed_length;
+        if(s->config.stats)
+            stats_cut(&s->stats, s->removed_length);
+
+        if(s->callbacks.truncate(s->user, s->written_length) == -1)
+            return -1;
+    }
+
+    return 0;
+}
+
+/* remember audio while not recording, oldest is overwritten */
+static void segmenter_preroll_add(segmenter *s, int16_t *buffer, int length)
+{
+    int n;
+
+    if(length > s->preroll_length)
+    {
+        buffer += length - s->preroll_length;
+        length = s->preroll_length;
+    }
+
+    while(length > 0)
+    {
+        n = s->preroll_length - s->preroll_position;
+        if(n > length)
+            n = length;
+        memcpy(s->preroll + s->preroll_position, buffer, n * sizeof(int16_t));
+        s->preroll_position = (s->preroll_position + n) % s->preroll_length;
+        buffer += n;
+        length -= n;
+        s->preroll_used += n;
+    }
+
+    if(s->preroll_used > s->preroll_length)
+        s->preroll_used = s->preroll_length;
+}
+
+/* start clip with what was remembered, oldest first and a slice at a time */
+static int segmenter_preroll_write(segmenter *s)
+{
+    int position, n;
+
+    position = (s->preroll_position - s->preroll_used + s->preroll_length) % s->preroll_length;
+    s->cut_length += s->preroll_used;
+
+    while(s->preroll_used > 0)
+    {
+        n = s->preroll_length - position;
+        if(n > s->preroll_used)
+            n = s->preroll_used;
+        if(n > s->slice_length)
+            n = s->slice_length;
+        if(segmenter_write(s, s->preroll + position, n) == -1)
+            return -1;
+        position = (position + n) % s->preroll_length;
+        s->preroll_used -= n;
+    }
+
+    return 0;
+}
+
+static int segmenter_slice(segmenter *s, int16_t *buffer, int length)
+{
+    int16_t *detect_buffer;
+    int detect_length;
+    int active;
+
+    if(s->decimate.factor > 1)
+    {
+        detect_length = decimator_process(&s->decimate, buffer, length);
+        detect_buffer = s->decimate.buffer;
+    }
+    else
+    {
+        detect_length = length;
+        detect_buffer = buffer;
+    }
+
+    if(s->config.window_length != 0)
+        s->level = energy_window_process(&s->window, detect_buffer, detect_length);
+    else
+        s->level = root_mean_square(detect_buffer, detect_length);
+
+    if(s->config.vad)
+        active = vad_process(&s->vad, detect_buffer, detect_length, s->config.threshold);
+    else
+        active = (s->level > s->config.threshold);
+
+    s->total_length += length;
+
+    if(s->recording == 1)
+    {
+        if((double)s->peak_length / s->config.sample_rate > s->config.runlength)
+            /* remove runlength seconds of silence at end of recording */
+            return segmenter_stop(s, s->config.runlength * s->config.sample_rate);
+
+        s->cut_length += length;
+        s->peak_length += length;
+
+        if(active)
+            s->peak_length = 0;
+
+        return segmenter_write(s, buffer, length);
+    }
+    else if(active)
+    {
+        s->recording = 1;
+        s->clip_start = s->total_length - length - s->preroll_used;
+        s->write_offset = s->clip_start;
+        if(s->config.stats)
+            stats_begin(&s->stats);
+
+        if(s->callbacks.start(s->user, s->clip_start) == -1)
+            return -1;
+
+        if(s->preroll_used > 0 && segmenter_preroll_write(s) == -1)
+            return -1;
+
+        return segmenter_write(s, buffer, length);
+    }
+    else if(s->preroll_length > 0)
+        segmenter_preroll_add(s, buffer, length);
+
+    return 0;
+}
+
+/* feed samples, any length. whole slices are used directly from buffer and
+ * only what does not fill a slice is copied and kept for the next push */
+int segmenter_push(segmenter *s, int16_t *buffer, int length)
+{
+    int n;
+
+    if(s->slice_used > 0)
+    {
+        n = s->slice_length - s->slice_used;
+        if(n > length)
+            n = length;
+        memcpy(s->slice + s->slice_used, buffer, n * sizeof(int16_t));
+        s->slice_used += n;
+        buffer += n;
+        length -= n;
+
+        if(s->slice_used < s->slice_length)
+            return 0;
+
+        s->slice_used = 0;
+        if(segmenter_slice(s, s->slice, s->slice_length) == -1)
+            return -1;
+    }
+
+    while(length >= s->slice_length)
+    {
+        if(segmenter_slice(s, buffer, s->slice_length) == -1)
+            return -1;
+        buffer += s->slice_length;
+        length -= s->slice_length;
+    }
+
+    if(length > 0)
+    {
+        memcpy(s->slice, buffer, length * sizeof(int16_t));
+        s->slice_used = length;
+    }
+
+    return 0;
+}
+
+/* end of stream, use what is left and close clip if recording */
+int segmenter_finish(segmenter *s)
+{
+    uint64_t trailing;
+    int n;
+
+    if(s->slice_used > 0)
+    {
+        n = s->slice_used;
+        s->slice_used = 0;
+        if(segmenter_slice(s, s->slice, n) == -1)
+            return -1;
+    }
+
+    if(s->recording == 0)
+        return 0;
+
+    /* cut silence at end, but never more then there is */
+    trailing = s->config.runlength * s->config.sample_rate;
+    if(s->peak_length < trailing)
+        trailing = s->peak_length;
+
+    return segmenter_stop(s, trailing);
+}
+
@@ -0,0 +1,95 @@
+#ifndef __SEGMENT_H__
+#define __SEGMENT_H__
+
+#include <stdint.h>
+
+#include "energy.h"
+#include "decimate.h"
+#include "stats.h"
+#include "vad.h"
+
+struct segment_config
+{
+    int sample_rate;
+    double slice_divisor; /* slices per second */
+    double threshold;
+    double runlength; /* seconds */
+    double short_filter; /* seconds, 0 = dont filter */
+    double window_length; /* seconds, 0 = rms of each slice */
+    double window_hop; /* seconds, 0 = every sample */
+    int detect_rate; /* Hz, 0 = full sample rate */
+    double compact_length; /* seconds, 0 = dont compact */
+    double compact_gap; /* seconds */
+    int stats; /* collect peak, rms, clipping and loudness of clips */
+    int vad; /* trigger on speech, threshold is only a level floor */
+};
+
+typedef struct segment_config segment_config;
+
+/* all callbacks return 0 on success, -1 makes segmenter_push fail. offsets are
+ * in samples from start of stream, lengths and positions in samples */
+struct segment_callbacks
+{
+    /* activity found, a clip starts at offset */
+    int (*start)(void *user, uint64_t offset);
+    /* append samples to current clip, at most one slice. buffer is from
+     * write_offset in the stream */
+    int (*write)(void *user, int16_t *buffer, int length);
+    /* cut current clip down to length samples */
+    int (*truncate)(void *user, uint64_t length);
+    /* length samples of silence was removed at position in clip, offset is
+     * where it was in the original audio counted from clip start. optional */
+    int (*compact)(void *user, uint64_t position, uint64_t offset, uint64_t length);
+    /* clip ended, length is its duration in original audio. keep is 0 if the
+     * short filter says it should be thrown away */
+    int (*stop)(void *user, uint64_t offset, uint64_t length, int keep);
+};
+
+typedef struct segment_callbacks segment_callbacks;
+
+struct segmenter
+{
+    segment_config config;
+    segment_callbacks callbacks;
+    void *user;
+
+    int slice_length;
+    int16_t *slice; /* partial slice left over between pushes */
+    int slice_used;
+    energy_window window;
+    decimator decimate;
+    stats stats; /* stats.clip is the current clip, valid in stop callback */
+    vad vad;
+    int16_t *preroll; /* audio before a clip, vad decides late */
+    int preroll_length;
+    int preroll_position;
+    int preroll_used;
+
+    /* state, fine to read from callbacks */
+    double level; /* level of last slice, 0-1 */
+    int recording;
+    uint64_t total_length;
+    uint64_t cut_length;
+    uint64_t peak_length; /* silence since last sound */
+    uint64_t clip_start;
+    uint64_t written_length;
+    uint64_t write_offset; /* stream offset of audio given to segmenter_write */
+    uint64_t removed_start;
+    uint64_t removed_length;
+    uint64_t removed_total; /* inside clip, at stop without trailing silence */
+    int compacting;
+    uint64_t gap_length; /* silence kept by current compaction */
+};
+
+typedef struct segmenter segmenter;
+
+
+int segmenter_check_config(segment_config *config);
+int segmenter_init(segmenter *s, segment_config *config, segment_callbacks *callbacks, void *user);
+int segmenter_configure(segmenter *s, segment_config *config);
+int segmenter_push(segmenter *s, int16_t *buffer, int length);
+int segmenter_finish(segmenter *s);
+void segmenter_free(segmenter *s);
+
+#endif
+
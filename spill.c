@@ -0,0 +1,110 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "spill.h"
+
+
+int spill_init(spill *s, int size)
+{
+    s->data = NULL;
+    s->size = size;
+    s->used = 0;
+
+    if(size > 0)
+    {
+        s->data = malloc(size);
+        if(s->data == NULL)
+        {
+            fprintf(stderr, "spill_init: malloc failed\n");
+
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+void spill_free(spill *s)
+{
+    free(s->data);
+    s->data = NULL;
+}
+
+/* write as much as possible to fd, returns number of bytes written. unlike a
+ * stdio stream we know exactly what made it to the file if it fails */
+int spill_write(int fd, void *data, int bytes)
+{
+    ssize_t r;
+    int written = 0;
+
+    while(written < bytes)
+    {
+        r = write(fd, (uint8_t *)data + written, bytes - written);
+        if(r == -1 && errno == EINTR)
+            continue;
+        if(r < 1)
+            break;
+        written += r;
+    }
+
+    return written;
+}
+
+/* queue bytes, returns number of bytes that fit */
+int spill_add(spill *s, void *data, int bytes)
+{
+    if(bytes > s->size - s->used)
+        bytes = s->size - s->used;
+    memcpy(s->data + s->used, data, bytes);
+    s->used += bytes;
+
+    return bytes;
+}
+
+/* try to write queued bytes, returns number of bytes written */
+int spill_flush(spill *s, int fd)
+{
+    int n;
+
+    if(s->used == 0)
+        return 0;
+
+    n = spill_write(fd, s->data, s->used);
+    memmove(s->data, s->data + n, s->used - n);
+    s->used -= n;
+
+    return n;
+}
+
+/* keep only the first bytes */
+void spill_truncate(spill *s, int bytes)
+{
+    if(bytes < s->used)
+        s->used = bytes;
+}
+
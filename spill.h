@@ -0,0 +1,25 @@
+#ifndef __SPILL_H__
+#define __SPILL_H__
+
+#include <stdint.h>
+
+/* bounded memory queue for output that could not be written yet */
+struct spill
+{
+    uint8_t *data;
+    int size;
+    int used;
+};
+
+typedef struct spill spill;
+
+
+int spill_init(spill *s, int size);
+void spill_free(spill *s);
+int spill_write(int fd, void *data, int bytes);
+int spill_add(spill *s, void *data, int bytes);
+int spill_flush(spill *s, int fd);
+void spill_truncate(spill *s, int bytes);
+
+#endif
+
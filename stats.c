@@ -0,0 +1,276 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "stats.h"
+
+
+/* K-weighting filter coefficients for any sample rate, same as the 48 kHz
+ * ones in ITU-R BS.1770 but calculated with the bilinear transform */
+static void stats_k_weighting(stats *s, int sample_rate)
+{
+    double f0, g, q, k, vh, vb, a0;
+
+    /* high shelf, +4 dB above about 1.5 kHz */
+    f0 = 1681.974450955533;
+    g = 3.999843853973347;
+    q = 0.7071752369554196;
+    k = tan(M_PI * f0 / sample_rate);
+    vh = pow(10.0, g / 20.0);
+    vb = pow(vh, 0.4996667741545416);
+    a0 = 1.0 + k / q + k * k;
+    s->shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    s->shelf.b1 = 2.0 * (k * k - vh) / a0;
+    s->shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    s->shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    s->shelf.a2 = (1.0 - k / q + k * k) / a0;
+
+    /* highpass at about 38 Hz */
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / sample_rate);
+    a0 = 1.0 + k / q + k * k;
+    s->highpass.b0 = 1.0;
+    s->highpass.b1 = -2.0;
+    s->highpass.b2 = 1.0;
+    s->highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+    s->highpass.a2 = (1.0 - k / q + k * k) / a0;
+}
+
+static double stats_biquad_run(stats_biquad *f, double x)
+{
+    double y;
+
+    y = f->b0 * x + f->b1 * f->x1 + f->b2 * f->x2 - f->a1 * f->y1 - f->a2 * f->y2;
+    f->x2 = f->x1;
+    f->x1 = x;
+    f->y2 = f->y1;
+    f->y1 = y;
+
+    return y;
+}
+
+static void stats_clip_reset(clip_stats *c)
+{
+    memset(c, 0, sizeof(*c));
+}
+
+void stats_init(stats *s, int sample_rate)
+{
+    stats_k_weighting(s, sample_rate);
+    s->sub_length = sample_rate / 10;
+    if(s->sub_length < 1)
+        s->sub_length = 1;
+    s->held = NULL;
+    s->held_size = 0;
+    stats_begin(s);
+}
+
+void stats_free(stats *s)
+{
+    free(s->held);
+    s->held = NULL;
+    s->held_size = 0;
+}
+
+/* new clip, forget everything */
+void stats_begin(stats *s)
+{
+    s->shelf.x1 = s->shelf.x2 = s->shelf.y1 = s->shelf.y2 = 0;
+    s->highpass.x1 = s->highpass.x2 = s->highpass.y1 = s->highpass.y2 = 0;
+    s->sub_position = 0;
+    s->sub_sum = 0;
+    s->sub_count = 0;
+    stats_clip_reset(&s->clip);
+    s->held_length = 0;
+}
+
+/* a 400 ms block is done every 100 ms, count it if above absolute gate */
+static void stats_block(stats *s)
+{
+    double z, l;
+    int i;
+
+    s->sub_sums[s->sub_count++ % 4] = s->sub_sum;
+    s->sub_sum = 0;
+    if(s->sub_count < 4)
+        return;
+
+    z = (s->sub_sums[0] + s->sub_sums[1] + s->sub_sums[2] + s->sub_sums[3]) /
+        (4.0 * s->sub_length);
+    if(z <= 0)
+        return;
+
+    l = -0.691 + 10.0 * log10(z);
+    if(l < STATS_HISTOGRAM_MIN)
+        return;
+
+    i = (l - STATS_HISTOGRAM_MIN) * 10;
+    if(i >= STATS_HISTOGRAM_SIZE)
+        i = STATS_HISTOGRAM_SIZE - 1;
+    s->clip.histogram[i]++;
+}
+
+static void stats_process(stats *s, int16_t *buffer, int length)
+{
+    int i;
+    int32_t a;
+    double x, y;
+    clip_stats *p = &s->clip;
+
+    for(i = 0; i < length; i++)
+    {
+        a = buffer[i];
+        if(a < 0)
+            a = -a;
+        if(a > p->peak)
+            p->peak = a;
+        if(a >= INT16_MAX)
+            p->clipped++;
+
+        x = buffer[i] / 32768.0;
+        p->sum += x * x;
+
+        y = stats_biquad_run(&s->highpass, stats_biquad_run(&s->shelf, x));
+        s->sub_sum += y * y;
+        if(++s->sub_position == s->sub_length)
+        {
+            s->sub_position = 0;
+            stats_block(s);
+        }
+    }
+
+    p->samples += length;
+}
+
+/* audio written to the clip, held until stats_keep says it stays */
+int stats_hold(stats *s, int16_t *buffer, int length)
+{
+    int16_t *t;
+    int size;
+
+    if(s->held_length + length > s->held_size)
+    {
+        size = (s->held_length + length) * 2;
+        t = realloc(s->held, size * sizeof(int16_t));
+        if(t == NULL)
+        {
+            fprintf(stderr, "stats_hold: realloc failed\n");
+
+            return -1;
+        }
+        s->held = t;
+        s->held_size = size;
+    }
+    memcpy(s->held + s->held_length, buffer, length * sizeof(int16_t));
+    s->held_length += length;
+
+    return 0;
+}
+
+/* held audio except the newest samples is part of the clip */
+void stats_keep(stats *s, int newest)
+{
+    int n;
+
+    n = s->held_length - newest;
+    if(n <= 0)
+        return;
+
+    stats_process(s, s->held, n);
+    memmove(s->held, s->held + n, newest * sizeof(int16_t));
+    s->held_length = newest;
+}
+
+/* newest held samples were cut away */
+void stats_cut(stats *s, uint64_t length)
+{
+    if(length > s->held_length)
+        length = s->held_length;
+    s->held_length -= length;
+}
+
+/* dBFS */
+double stats_peak(clip_stats *c)
+{
+    return 20.0 * log10(c->peak / 32768.0);
+}
+
+/* dBFS, full scale sine is -3 */
+double stats_rms(clip_stats *c)
+{
+    if(c->samples == 0)
+        return -INFINITY;
+
+    return 10.0 * log10(c->sum / c->samples);
+}
+
+/* integrated loudness in LUFS, EBU R128 gating using block histogram */
+double stats_loudness(clip_stats *c)
+{
+    int i, gate;
+    double z, sum;
+    uint64_t n;
+
+    sum = 0;
+    n = 0;
+    for(i = 0; i < STATS_HISTOGRAM_SIZE; i++)
+    {
+        sum += c->histogram[i] * pow(10.0, (STATS_HISTOGRAM_MIN + (i + 0.5) / 10.0 + 0.691) / 10.0);
+        n += c->histogram[i];
+    }
+    if(n == 0)
+        return -INFINITY;
+
+    /* relative gate 10 LU below the absolute gated loudness */
+    z = -0.691 + 10.0 * log10(sum / n) - 10.0;
+    gate = (z - STATS_HISTOGRAM_MIN) * 10;
+    if(gate < 0)
+        gate = 0;
+
+    sum = 0;
+    n = 0;
+    for(i = gate; i < STATS_HISTOGRAM_SIZE; i++)
+    {
+        sum += c->histogram[i] * pow(10.0, (STATS_HISTOGRAM_MIN + (i + 0.5) / 10.0 + 0.691) / 10.0);
+        n += c->histogram[i];
+    }
+    if(n == 0)
+        return -INFINITY;
+
+    return -0.691 + 10.0 * log10(sum / n);
+}
+
+int stats_format(clip_stats *c, char *buffer, int size)
+{
+    return snprintf(buffer, size,
+                    "peak=%.1f dBFS rms=%.1f dBFS clipped=%llu loudness=%.1f LUFS",
+                    stats_peak(c),
+                    stats_rms(c),
+                    (unsigned long long)c->clipped,
+                    stats_loudness(c)
+                    );
+}
+
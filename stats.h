@@ -0,0 +1,59 @@
+#ifndef __STATS_H__
+#define __STATS_H__
+
+#include <stdint.h>
+
+/* gating block loudness in 0.1 LU steps from -70 to +5 LUFS */
+#define STATS_HISTOGRAM_MIN -70.0
+#define STATS_HISTOGRAM_SIZE 750
+
+struct stats_biquad
+{
+    double b0, b1, b2, a1, a2;
+    double x1, x2, y1, y2;
+};
+
+typedef struct stats_biquad stats_biquad;
+
+struct clip_stats
+{
+    uint64_t samples;
+    double sum; /* sum of squares */
+    int32_t peak; /* largest absolute sample */
+    uint64_t clipped; /* samples at full scale */
+    uint32_t histogram[STATS_HISTOGRAM_SIZE];
+};
+
+typedef struct clip_stats clip_stats;
+
+struct stats
+{
+    stats_biquad shelf; /* EBU R128 K-weighting */
+    stats_biquad highpass;
+    int sub_length; /* 100 ms */
+    int sub_position;
+    double sub_sum;
+    double sub_sums[4]; /* last four make a 400 ms gating block */
+    int sub_count;
+    clip_stats clip;
+    int16_t *held; /* written but might still be cut */
+    int held_length;
+    int held_size;
+};
+
+typedef struct stats stats;
+
+
+void stats_init(stats *s, int sample_rate);
+void stats_free(stats *s);
+void stats_begin(stats *s);
+int stats_hold(stats *s, int16_t *buffer, int length);
+void stats_keep(stats *s, int newest);
+void stats_cut(stats *s, uint64_t length);
+double stats_peak(clip_stats *c);
+double stats_rms(clip_stats *c);
+double stats_loudness(clip_stats *c);
+int stats_format(clip_stats *c, char *buffer, int size);
+
+#endif
+
@@ -0,0 +1,284 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "vad.h"
+
+
+/* loops over whole frames are kept free of branches and use eight partial
+ * sums, that way gcc -O3 vectorizes them without needing fast math */
+
+/* sum of a[i] * b[i], n is a multiple of 8 */
+static float vad_dot(float *restrict a, float *restrict b, int n)
+{
+    float lane[8] = {0};
+    int i, j;
+
+    for(i = 0; i < n; i += 8)
+        for(j = 0; j < 8; j++)
+            lane[j] += a[i + j] * b[i + j];
+
+    return ((lane[0] + lane[1]) + (lane[2] + lane[3])) +
+           ((lane[4] + lane[5]) + (lane[6] + lane[7]));
+}
+
+int vad_init(vad *v, int sample_rate)
+{
+    int n, i, half, k, stage;
+    double frame_seconds;
+
+    /* largest power of two that fits in frame time */
+    for(n = 64; n * 2 <= sample_rate * VAD_FRAME_SECONDS; n *= 2)
+        ;
+
+    v->sample_rate = sample_rate;
+    v->frame_length = n;
+    v->frame_used = 0;
+    v->frame = malloc(n * sizeof(int16_t));
+    v->window = malloc(n * sizeof(float));
+    v->twiddle_re = malloc(n * sizeof(float));
+    v->twiddle_im = malloc(n * sizeof(float));
+    v->re = malloc(n * sizeof(float));
+    v->im = malloc(n * sizeof(float));
+    v->power = malloc(n * sizeof(float));
+    v->log_power = malloc(n * sizeof(float));
+    v->bins = calloc(n, sizeof(float));
+    v->voice = calloc(n, sizeof(float));
+    if(v->frame == NULL || v->window == NULL ||
+       v->twiddle_re == NULL || v->twiddle_im == NULL ||
+       v->re == NULL || v->im == NULL ||
+       v->power == NULL || v->log_power == NULL ||
+       v->bins == NULL || v->voice == NULL)
+    {
+        fprintf(stderr, "vad_init: malloc failed\n");
+        vad_free(v);
+
+        return -1;
+    }
+
+    for(i = 0; i < n; i++)
+        v->window[i] = 0.5 - 0.5 * cos(2 * M_PI * i / n);
+
+    /* twiddles for each stage one after the other, stage with half h uses
+     * exp(-2 pi i j / 2h) for j < h */
+    stage = 0;
+    for(half = n / 2; half >= 1; half /= 2)
+    {
+        for(i = 0; i < half; i++)
+        {
+            v->twiddle_re[stage + i] = cos(M_PI * i / half);
+            v->twiddle_im[stage + i] = -sin(M_PI * i / half);
+        }
+        stage += half;
+    }
+
+    /* mark bins by where they end up after bit reversal */
+    v->bin_count = 0;
+    for(k = 1; k < n / 2; k++)
+    {
+        for(i = 0, half = 1; half < n; half *= 2)
+            i = (i << 1) | ((k & half) != 0);
+
+        v->bins[i] = 1;
+        v->bin_count++;
+        if(k * (double)sample_rate / n >= VAD_BAND_LOW &&
+           k * (double)sample_rate / n <= VAD_BAND_HIGH)
+            v->voice[i] = 1;
+    }
+
+    frame_seconds = (double)n / sample_rate;
+    v->onset = ceil(VAD_ONSET_SECONDS / frame_seconds);
+    v->hangover = ceil(VAD_HANGOVER_SECONDS / frame_seconds);
+    v->noise = -1;
+    v->run = 0;
+    v->hold = 0;
+    v->active = 0;
+    v->level = 0;
+    v->zcr = 0;
+    v->flatness = 0;
+    v->band_ratio = 0;
+
+    return 0;
+}
+
+void vad_free(vad *v)
+{
+    free(v->frame);
+    free(v->window);
+    free(v->twiddle_re);
+    free(v->twiddle_im);
+    free(v->re);
+    free(v->im);
+    free(v->power);
+    free(v->log_power);
+    free(v->bins);
+    free(v->voice);
+    v->frame = NULL;
+    v->window = NULL;
+    v->twiddle_re = NULL;
+    v->twiddle_im = NULL;
+    v->re = NULL;
+    v->im = NULL;
+    v->power = NULL;
+    v->log_power = NULL;
+    v->bins = NULL;
+    v->voice = NULL;
+}
+
+/* one block of a fft stage, the two halves never overlap */
+static void vad_butterfly(float *restrict ar, float *restrict ai,
+                          float *restrict br, float *restrict bi,
+                          float *restrict wr, float *restrict wi, int half)
+{
+    float tr, ti;
+    int j;
+
+    for(j = 0; j < half; j++)
+    {
+        tr = ar[j] - br[j];
+        ti = ai[j] - bi[j];
+        ar[j] += br[j];
+        ai[j] += bi[j];
+        br[j] = tr * wr[j] - ti * wi[j];
+        bi[j] = tr * wi[j] + ti * wr[j];
+    }
+}
+
+/* radix 2 decimation in frequency, in place, output in bit reversed order */
+static void vad_fft(vad *v)
+{
+    int n = v->frame_length;
+    int half, start, stage;
+
+    stage = 0;
+    for(half = n / 2; half >= 1; half /= 2)
+    {
+        for(start = 0; start < n; start += 2 * half)
+            vad_butterfly(v->re + start, v->im + start,
+                          v->re + start + half, v->im + start + half,
+                          v->twiddle_re + stage, v->twiddle_im + stage, half);
+        stage += half;
+    }
+}
+
+/* features of a full frame and update of the state machine */
+static void vad_frame(vad *v, double threshold)
+{
+    int16_t *restrict x = v->frame;
+    float *restrict window = v->window;
+    float *restrict re = v->re;
+    float *restrict im = v->im;
+    float *restrict power = v->power;
+    float *restrict log_power = v->log_power;
+    int n = v->frame_length;
+    int64_t sum = 0;
+    int crossings = 0;
+    int i, speech;
+    double mean_square, total;
+
+    for(i = 0; i < n; i++)
+        sum += x[i] * x[i];
+    for(i = 1; i < n; i++)
+        crossings += (x[i] ^ x[i - 1]) < 0;
+
+    for(i = 0; i < n; i++)
+    {
+        re[i] = x[i] * window[i];
+        im[i] = 0;
+    }
+    vad_fft(v);
+    for(i = 0; i < n; i++)
+        power[i] = re[i] * re[i] + im[i] * im[i] + 1e-3f;
+    for(i = 0; i < n; i++)
+        log_power[i] = logf(power[i]);
+
+    total = vad_dot(power, v->bins, n);
+    mean_square = (double)sum / n;
+    v->level = sqrt(mean_square) / INT16_MAX;
+    v->zcr = crossings * (double)v->sample_rate / (2 * n);
+    /* geometric mean over arithmetic mean */
+    v->flatness = exp(vad_dot(log_power, v->bins, n) / v->bin_count) /
+                  (total / v->bin_count);
+    v->band_ratio = vad_dot(power, v->voice, n) / total;
+
+    if(v->noise < 0)
+        v->noise = mean_square;
+
+    speech = (v->level > threshold &&
+              mean_square > v->noise * VAD_NOISE_RATIO &&
+              v->flatness < VAD_FLATNESS_MAX &&
+              ((v->zcr >= VAD_ZCR_MIN && v->zcr <= VAD_ZCR_MAX) ||
+               v->band_ratio > VAD_BAND_RATIO_MIN));
+
+    /* noise floor drops at once and rises slowly, only outside speech */
+    if(!speech)
+    {
+        if(mean_square < v->noise)
+            v->noise = mean_square;
+        else
+            v->noise += (mean_square - v->noise) * VAD_NOISE_ADAPT;
+    }
+
+    /* onset needs a run of speech, a short bang is not enough. once active
+     * hangover keeps it so through short pauses */
+    v->run = (speech ? v->run + 1 : 0);
+    if(v->run >= v->onset || (v->active && speech))
+    {
+        v->active = 1;
+        v->hold = v->hangover;
+    }
+    else if(v->hold > 0)
+        v->hold--;
+    else
+        v->active = 0;
+}
+
+/* feed samples, returns 1 if speech is going on, 0 if not. decision is made
+ * per frame and lags about onset time behind */
+int vad_process(vad *v, int16_t *buffer, int length, double threshold)
+{
+    int n;
+
+    while(length > 0)
+    {
+        n = v->frame_length - v->frame_used;
+        if(n > length)
+            n = length;
+        memcpy(v->frame + v->frame_used, buffer, n * sizeof(int16_t));
+        v->frame_used += n;
+        buffer += n;
+        length -= n;
+
+        if(v->frame_used == v->frame_length)
+        {
+            v->frame_used = 0;
+            vad_frame(v, threshold);
+        }
+    }
+
+    return v->active;
+}
+
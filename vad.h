@@ -0,0 +1,62 @@
+#ifndef __VAD_H__
+#define __VAD_H__
+
+#include <stdint.h>
+
+/* frame is speech like if it is louder then the noise, the spectrum is not
+ * flat like noise and zero crossing rate or voice band ratio agree */
+#define VAD_FRAME_SECONDS 0.032
+#define VAD_ONSET_SECONDS 0.08
+#define VAD_HANGOVER_SECONDS 0.2
+#define VAD_NOISE_RATIO 4.0 /* mean square over noise floor, 6 dB */
+#define VAD_NOISE_ADAPT 0.02 /* per frame, how fast noise floor rises */
+#define VAD_ZCR_MIN 100.0 /* Hz */
+#define VAD_ZCR_MAX 3000.0
+#define VAD_FLATNESS_MAX 0.3
+#define VAD_BAND_LOW 300.0 /* Hz */
+#define VAD_BAND_HIGH 3400.0
+#define VAD_BAND_RATIO_MIN 0.5
+
+struct vad
+{
+    int sample_rate;
+    int frame_length; /* power of two */
+    int frame_used;
+    int16_t *frame;
+
+    /* fft is decimation in frequency, output bins are in bit reversed order
+     * so bins are picked with weights instead of by index */
+    float *window; /* hann */
+    float *twiddle_re; /* per stage, frame_length - 1 */
+    float *twiddle_im;
+    float *re;
+    float *im;
+    float *power;
+    float *log_power;
+    float *bins; /* 1 for bins between dc and nyquist */
+    float *voice; /* 1 for bins in voice band */
+    float bin_count;
+
+    int onset; /* speech frames in a row needed to start */
+    int hangover; /* frames to stay active after speech */
+    double noise; /* noise floor, mean square, -1 = not known yet */
+    int run;
+    int hold;
+    int active;
+
+    /* features of last frame */
+    double level; /* rms, 0-1 */
+    double zcr; /* Hz */
+    double flatness; /* 0-1, 1 is white noise */
+    double band_ratio; /* part of energy in voice band */
+};
+
+typedef struct vad vad;
+
+
+int vad_init(vad *v, int sample_rate);
+void vad_free(vad *v);
+int vad_process(vad *v, int16_t *buffer, int length, double threshold);
+
+#endif
+
@@ -19,11 +19,13 @@
  */
 
 #include <stdio.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <string.h>
 
 #include "riff.h"
 #include "wav.h"
+#include "flac.h"
 
 
 int wav_open_write(char *file, wav_file *w)
@@ -60,18 +62,42 @@ int wav_open_write(char *file, wav_file *w)
 
 int wav_open_read(char *file, wav_file *w)
 {
+    FILE *stream;
+
     if(file == NULL)
-        w->stream = stdin;
+        stream = stdin;
     else
     {
-        w->stream = fopen(file, "r");
-        if(w->stream == NULL)
+        stream = fopen(file, "r");
+        if(stream == NULL)
         {
             fprintf(stderr, "wav_open_read: fopen for read failed\n");
             
             return -1;
         }
     }
+
+    return wav_open_stream(stream, w);
+}
+
+/* read header from an already open stream, closes it on failure. FLAC is
+ * decoded, told apart by first byte of "fLaC" or of an "ID3" tag */
+int wav_open_stream(FILE *stream, wav_file *w)
+{
+    int c;
+
+    c = getc(stream);
+    if(c == EOF || ungetc(c, stream) == EOF)
+    {
+        fprintf(stderr, "wave_open_read: Failed to read RIFF header\n");
+        fclose(stream);
+
+        return -1;
+    }
+    if(c == 'f' || c == 'I')
+        return flac_open_stream(stream, w);
+
+    w->stream = stream;
         
     if(riff_read_chunk(w->stream, &w->riff) == -1 ||
        riff_read_sub_chunk_wave_format(w->stream, &w->format) == -1 ||
@@ -115,26 +141,76 @@ int wav_open_read(char *file, wav_file *w)
         return -1;
     }
 
+    w->data_offset = ftello(w->stream);
+
+    return 0;
+}
+
+/* headerless 16 bit mono PCM, format is made up from sample rate */
+int wav_open_raw(FILE *stream, int sample_rate, wav_file *w)
+{
+    w->stream = stream;
+
+    memcpy(w->riff.id, "RIFF", 4);
+    memcpy(w->riff.format, "WAVE", 4);
+    memcpy(w->format.id, "fmt ", 4);
+    memcpy(w->data.id, "data", 4);
+    w->riff.size = INT32_MAX;
+    w->data.size = INT32_MAX;
+    w->format.size = sizeof(w->format) - sizeof(w->format.id) - sizeof(w->format.size);
+    w->format.audio_format = 1; /* PCM */
+    w->format.num_channels = 1;
+    w->format.sample_rate = sample_rate;
+    w->format.byte_rate = sample_rate * sizeof(int16_t);
+    w->format.block_align = sizeof(int16_t);
+    w->format.bits_per_sample = 16;
+    w->data_offset = ftello(stream);
+
     return 0;
 }
 
 int wav_close_write(wav_file *w)
+{
+    return wav_close_write_chunks(w, NULL, 0);
+}
+
+/* as wav_close_write but also put size bytes of complete chunks after the
+ * audio data, eg a LIST chunk */
+int wav_close_write_chunks(wav_file *w, void *chunks, int size)
 {
     /* seek to end of file */
     if(fseek(w->stream, 0, SEEK_END) == -1)
     {
         fprintf(stderr, "wav_close_write: fseek end failed\n");
+        fclose(w->stream);
 
         return -1;
     }
     
-    w->riff.size = ftell(w->stream) - 8; /* total size - parts of riff header */
     w->data.size = ftell(w->stream) - sizeof(w->riff) - sizeof(w->format) - sizeof(w->data);
+    /* chunks start at even offsets, an odd data chunk is followed by a pad
+     * byte that is not part of its size */
+    if(size > 0 && w->data.size % 2 == 1 && putc(0, w->stream) == EOF)
+    {
+        fprintf(stderr, "wav_close_write: Failed to write pad byte\n");
+        fclose(w->stream);
+
+        return -1;
+    }
+    if(size > 0 && fwrite(chunks, size, 1, w->stream) != 1)
+    {
+        fprintf(stderr, "wav_close_write: Failed to write chunks\n");
+        fclose(w->stream);
+
+        return -1;
+    }
+    w->riff.size = ftell(w->stream) - 8; /* total size - parts of riff header */
     
     /* seek to beginning of file */
     if(fseek(w->stream, 0, SEEK_SET) == -1)
     {
         fprintf(stderr, "wav_close_write: fseek beginning failed\n");
+        fclose(w->stream);
 
         return -1;
     }
@@ -145,11 +221,17 @@ int wav_close_write(wav_file *w)
        riff_write_sub_chunk_wave_data(w->stream, &w->data) == -1)
     {
         fprintf(stderr, "wav_close_write: Failed to rewrite header\n");
+        fclose(w->stream);
 
         return -1;
     }
 
-    fclose(w->stream);
+    if(fclose(w->stream) == EOF)
+    {
+        fprintf(stderr, "wav_close_write: fclose failed\n");
+
+        return -1;
+    }
 
     return 0;
 }
@@ -171,5 +253,34 @@ void wav_truncate(wav_file *w, off_t size)
               /* align size to whole blocks */
               size - (size % w->format.block_align)
               );
+    /* continue writing at new end */
+    fseek(w->stream, 0, SEEK_END);
+}
+
+/* continue reading at sample, seeks if stream can, otherwise reads past */
+int wav_seek(wav_file *w, uint64_t sample)
+{
+    char b[4096];
+    uint64_t bytes;
+    int n;
+
+    bytes = sample * w->format.block_align;
+    if(w->data_offset != -1 &&
+       fseeko(w->stream, w->data_offset + bytes, SEEK_SET) == 0)
+        return 0;
+
+    while(bytes > 0)
+    {
+        n = (bytes < sizeof(b) ? bytes : sizeof(b));
+        if(fread(b, n, 1, w->stream) != 1)
+        {
+            fprintf(stderr, "wav_seek: input ended before seek position\n");
+
+            return -1;
+        }
+        bytes -= n;
+    }
+
+    return 0;
 }
 
@@ -3,6 +3,7 @@
 
 #include <stdio.h>
 #include <unistd.h>
+#include <stdint.h>
 
 #include "riff.h"
 
@@ -12,6 +13,7 @@ struct wav_file
     riff_chunk riff;
     riff_sub_chunk_wave_format format;
     riff_sub_chunk_wave_data data;
+    off_t data_offset; /* where samples start, -1 if stream can not seek */
 };
 
 typedef struct wav_file wav_file;
@@ -19,9 +21,13 @@ typedef struct wav_file wav_file;
 
 int wav_open_write(char *file, wav_file *w);
 int wav_open_read(char *file, wav_file *w);
+int wav_open_stream(FILE *stream, wav_file *w);
+int wav_open_raw(FILE *stream, int sample_rate, wav_file *w);
 int wav_close_write(wav_file *w);
+int wav_close_write_chunks(wav_file *w, void *chunks, int size);
 int wav_close_read(wav_file *w);
 void wav_truncate(wav_file *w, off_t size);
+int wav_seek(wav_file *w, uint64_t sample);
 
 #endif
 
@@ -0,0 +1,290 @@
+/*
+ * lurker, an audio silence splitter
+ * Copyright (C)2004 Mattias Wadman <mattias.wadman@softdays.se>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307 USA
+ *
+ */
+
+/* pipe input without copying audio thru user space on its way to the output
+ * file. input is tee:d to a pipe we read for detection and then spliced to a
+ * hold pipe, from there it is spliced to the output file or /dev/null when
+ * the segmenter has decided what to do with it. tee only duplicates, so
+ * moving input to hold right away makes sure each byte is seen once and that
+ * tee blocks normally while waiting for more input. input is read by one
+ * thread and hold emptied by another, if hold runs full input goes to
+ * /dev/null instead and output is written from the copy until hold has been
+ * emptied */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <endian.h>
+#include <byteswap.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "zerocopy.h"
+
+
+/* input is read in whole blocks of block bytes, as many as fit a page or
+ * more, see z->capacity. queue is bytes of input that can be read ahead of
+ * the segmenter, less if the hold pipe can not be made big enough, see
+ * z->queue */
+int zerocopy_open(int in, int block, int queue, zerocopy *z)
+{
+    struct stat st;
+    FILE *f;
+    int size, max, read;
+
+    if(fstat(in, &st) == -1 || !S_ISFIFO(st.st_mode))
+    {
+        fprintf(stderr, "zerocopy_open: input is not a pipe\n");
+
+        return -1;
+    }
+
+    if(pipe(z->copy) == -1)
+    {
+        fprintf(stderr, "zerocopy_open: pipe failed\n");
+
+        return -1;
+    }
+    if(pipe(z->hold) == -1)
+    {
+        fprintf(stderr, "zerocopy_open: pipe failed\n");
+        close(z->copy[0]);
+        close(z->copy[1]);
+
+        return -1;
+    }
+    z->null = open("/dev/null", O_WRONLY);
+    if(z->null == -1)
+    {
+        fprintf(stderr, "zerocopy_open: failed to open /dev/null\n");
+        zerocopy_close(z);
+
+        return -1;
+    }
+
+    /* pipes count pages not bytes and each splice uses at least one, read
+     * a page or more at a time so hold is not full of small pieces */
+    read = (sysconf(_SC_PAGESIZE) + block - 1) / block * block;
+
+    /* hold should fit what has not been decided yet, what is queued plus one
+     * new read. a read that is not page aligned uses two pages so leave
+     * plenty of room, never make it smaller then default. without privileges
+     * a pipe can be at most pipe-max-size */
+    size = fcntl(z->hold[1], F_GETPIPE_SZ);
+    if(size < queue * 2 + read * 8 &&
+       fcntl(z->hold[1], F_SETPIPE_SZ, queue * 2 + read * 8) == -1 &&
+       (f = fopen("/proc/sys/fs/pipe-max-size", "r")) != NULL)
+    {
+        if(fscanf(f, "%d", &max) == 1 && max > size)
+            fcntl(z->hold[1], F_SETPIPE_SZ, max);
+        fclose(f);
+    }
+    size = fcntl(z->hold[1], F_GETPIPE_SZ);
+    if(size < read * 8)
+    {
+        fprintf(stderr, "zerocopy_open: hold pipe too small\n");
+        zerocopy_close(z);
+
+        return -1;
+    }
+    if(queue > (size - read * 8) / 2)
+        queue = (size - read * 8) / 2;
+
+    z->in = in;
+    z->capacity = read;
+    z->queue = queue;
+    z->read = 0;
+    z->held = 0;
+    z->released = 0;
+    z->broken = 0;
+    z->carried = 0;
+    pthread_mutex_init(&z->mutex, NULL);
+
+    return 0;
+}
+
+void zerocopy_close(zerocopy *z)
+{
+    close(z->copy[0]);
+    close(z->copy[1]);
+    close(z->hold[0]);
+    close(z->hold[1]);
+    if(z->null != -1)
+    {
+        close(z->null);
+        pthread_mutex_destroy(&z->mutex);
+    }
+    z->null = -1;
+}
+
+/* get a copy of up to bytes of input, returns number of bytes, 0 at end */
+static int zerocopy_read(zerocopy *z, void *buffer, int bytes)
+{
+    ssize_t n, m, r;
+    int broken;
+
+    if(bytes > z->capacity)
+        bytes = z->capacity;
+
+    n = tee(z->in, z->copy[1], bytes, 0);
+    if(n < 1)
+        return (n == -1 && errno != EINTR ? -1 : 0);
+
+    pthread_mutex_lock(&z->mutex);
+    if(z->broken && z->released == z->held)
+    {
+        /* output has caught up, start over with an empty hold */
+        z->broken = 0;
+        z->held = z->read;
+        z->released = z->read;
+    }
+    broken = z->broken;
+    pthread_mutex_unlock(&z->mutex);
+
+    for(m = 0; m < n; m += r)
+    {
+        if(broken)
+        {
+            r = splice(z->in, NULL, z->null, NULL, n - m, SPLICE_F_MOVE);
+            if(r < 1)
+                return -1;
+
+            continue;
+        }
+
+        r = splice(z->in, NULL, z->hold[1], NULL, n - m, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if(r == -1 && errno == EAGAIN)
+            r = broken = 1;
+        if(r < 1)
+            return -1;
+
+        pthread_mutex_lock(&z->mutex);
+        if(broken)
+        {
+            z->broken = 1;
+            r = 0;
+        }
+        else
+            z->held += r;
+        pthread_mutex_unlock(&z->mutex);
+    }
+    z->read += n;
+
+    for(m = 0; m < n; m += r)
+    {
+        r = read(z->copy[0], (char *)buffer + m, n - m);
+        if(r < 1)
+            return -1;
+    }
+
+    return n;
+}
+
+/* like riff_read_wave_16, fills buffer unless input ends and returns number of
+ * samples read. a pipe can give us an odd number of bytes at the end, the last
+ * one is kept until next call */
+int zerocopy_read_wave_16(zerocopy *z, int16_t *buffer, int length)
+{
+    uint8_t *b = (uint8_t *)buffer;
+    int n, bytes;
+#if __BYTE_ORDER != __LITTLE_ENDIAN
+    int i;
+#endif
+
+    bytes = 0;
+    if(z->carried)
+        b[bytes++] = z->carry;
+
+    while(bytes < length * sizeof(int16_t))
+    {
+        n = zerocopy_read(z, b + bytes, length * sizeof(int16_t) - bytes);
+        if(n == -1)
+            return -1;
+        if(n == 0)
+            break;
+        bytes += n;
+    }
+
+    z->carried = bytes % 2;
+    if(z->carried)
+        z->carry = b[bytes - 1];
+
+#if __BYTE_ORDER != __LITTLE_ENDIAN
+    for(i = 0; i < bytes / 2; i++)
+        buffer[i] = bswap_16(buffer[i]);
+#endif
+
+    return bytes / 2;
+}
+
+static int zerocopy_move(zerocopy *z, int out, uint64_t bytes)
+{
+    ssize_t r;
+
+    while(bytes > 0)
+    {
+        r = splice(z->hold[0], NULL, out, NULL, bytes, SPLICE_F_MOVE);
+        if(r < 1)
+            return -1;
+        bytes -= r;
+        pthread_mutex_lock(&z->mutex);
+        z->released += r;
+        pthread_mutex_unlock(&z->mutex);
+    }
+
+    return 0;
+}
+
+/* drop held input before position */
+int zerocopy_release(zerocopy *z, uint64_t position)
+{
+    uint64_t released;
+
+    pthread_mutex_lock(&z->mutex);
+    if(position > z->held)
+        position = z->held;
+    released = z->released;
+    pthread_mutex_unlock(&z->mutex);
+
+    if(position <= released)
+        return 0;
+
+    return zerocopy_move(z, z->null, position - released);
+}
+
+/* move bytes of input starting at position to out, fails if it is not in
+ * hold */
+int zerocopy_write(zerocopy *z, int out, uint64_t position, int bytes)
+{
+    int held;
+
+    if(zerocopy_release(z, position) == -1)
+        return -1;
+
+    pthread_mutex_lock(&z->mutex);
+    held = (position == z->released && position + bytes <= z->held);
+    pthread_mutex_unlock(&z->mutex);
+    if(!held)
+        return -1;
+
+    return zerocopy_move(z, out, bytes);
+}
+
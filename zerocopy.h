@@ -0,0 +1,34 @@
+#ifndef __ZEROCOPY_H__
+#define __ZEROCOPY_H__
+
+#include <stdint.h>
+#include <pthread.h>
+
+struct zerocopy
+{
+    int in; /* input pipe */
+    int copy[2]; /* tee of input, read for detection */
+    int hold[2]; /* input is moved here until we know where it goes */
+    int null;
+    int capacity; /* bytes read at a time, whole blocks and at least a page */
+    int queue; /* bytes that can be read ahead of what is released */
+    uint64_t read; /* bytes of input */
+    uint64_t held; /* input before this is in hold or gone */
+    uint64_t released; /* and before this is gone */
+    int broken; /* hold ran full, output is written from copies for now */
+    pthread_mutex_t mutex; /* held and released, input is read by another thread */
+    uint8_t carry; /* odd byte from last read */
+    int carried;
+};
+
+typedef struct zerocopy zerocopy;
+
+
+int zerocopy_open(int in, int block, int queue, zerocopy *z);
+int zerocopy_read_wave_16(zerocopy *z, int16_t *buffer, int length);
+int zerocopy_write(zerocopy *z, int out, uint64_t position, int bytes);
+int zerocopy_release(zerocopy *z, uint64_t position);
+void zerocopy_close(zerocopy *z);
+
+#endif
+